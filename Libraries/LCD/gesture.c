@@ -0,0 +1,252 @@
+#include "gesture.h"
+
+#include <stdlib.h>
+
+/************************************************************************
+** Gesture recognizer :
+** Table driven state machine over touch sampler events
+** TAP is reported on release, so a double-tap is reported as TAP
+** followed by DOUBLE_TAP and no gesture waits for a timeout
+************************************************************************/
+#define G_IDLE 0
+#define G_PRESSED 1 // Down, not moved, long-press not yet reached
+#define G_HELD 2	// Long-press reported, waiting for release
+#define G_SWIPING 3 // Moved beyond move_tol
+#define G_TAPPED 4	// Released after a tap, double-tap window open
+#define G_STATES 5
+
+#define G_IN_DOWN TOUCH_EVT_DOWN
+#define G_IN_MOVE TOUCH_EVT_MOVE
+#define G_IN_UP TOUCH_EVT_UP
+#define G_IN_TICK 3
+#define G_INPUTS 4
+
+static Gesture_ConfigTypeDef g_cfg = {600, 300, 12, 40};
+
+static uint8_t g_state = G_IDLE;
+static uint8_t g_second;				 // Current press follows a tap
+static uint16_t g_x0, g_y0;				 // Press start
+static uint16_t g_x, g_y;				 // Last position
+static uint32_t g_t0;					 // Press start time
+static uint16_t g_tap_x, g_tap_y;		 // Last tap
+static uint32_t g_tap_t;				 // Last tap release time
+static Gesture_EventTypeDef *g_out;		 // Output of the running action
+static const Touch_EventTypeDef *g_in;	 // Input of the running action
+
+static void G_Emit(uint8_t type)
+{
+	g_out->type = type;
+	g_out->x = g_x0;
+	g_out->y = g_y0;
+	g_out->time = g_in->time;
+}
+
+static uint16_t G_Dist(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+	uint16_t dx = abs((int)x1 - (int)x0);
+	uint16_t dy = abs((int)y1 - (int)y0);
+	return (dx > dy) ? dx : dy;
+}
+
+/* Actions : run for (state, input), return next state */
+static uint8_t G_Stay(void)
+{
+	return g_state;
+}
+
+static uint8_t G_Press(void)
+{
+	g_second = (g_state == G_TAPPED &&
+				g_in->time - g_tap_t <= g_cfg.double_tap_ms &&
+				G_Dist(g_tap_x, g_tap_y, g_in->x, g_in->y) <= g_cfg.move_tol);
+	g_x0 = g_x = g_in->x;
+	g_y0 = g_y = g_in->y;
+	g_t0 = g_in->time;
+	return G_PRESSED;
+}
+
+static uint8_t G_Pressed_Move(void)
+{
+	g_x = g_in->x;
+	g_y = g_in->y;
+	if (G_Dist(g_x0, g_y0, g_x, g_y) > g_cfg.move_tol)
+		return G_SWIPING;
+	if (g_in->time - g_t0 >= g_cfg.long_press_ms)
+	{
+		G_Emit(GESTURE_LONG_PRESS);
+		return G_HELD;
+	}
+	return G_PRESSED;
+}
+
+static uint8_t G_Pressed_Tick(void)
+{
+	if (g_in->time - g_t0 >= g_cfg.long_press_ms)
+	{
+		G_Emit(GESTURE_LONG_PRESS);
+		return G_HELD;
+	}
+	return G_PRESSED;
+}
+
+static uint8_t G_Pressed_Up(void)
+{
+	G_Emit(g_second ? GESTURE_DOUBLE_TAP : GESTURE_TAP);
+	if (g_second)
+		return G_IDLE; // A third tap starts over
+	g_tap_x = g_x0;
+	g_tap_y = g_y0;
+	g_tap_t = g_in->time;
+	return G_TAPPED;
+}
+
+static uint8_t G_Swiping_Move(void)
+{
+	g_x = g_in->x;
+	g_y = g_in->y;
+	return G_SWIPING;
+}
+
+static uint8_t G_Swiping_Up(void)
+{
+	int16_t dx = (int16_t)g_x - (int16_t)g_x0;
+	int16_t dy = (int16_t)g_y - (int16_t)g_y0;
+
+	if (abs(dx) >= abs(dy) && abs(dx) >= g_cfg.swipe_min)
+		G_Emit(dx < 0 ? GESTURE_SWIPE_LEFT : GESTURE_SWIPE_RIGHT);
+	else if (abs(dy) > abs(dx) && abs(dy) >= g_cfg.swipe_min)
+		G_Emit(dy < 0 ? GESTURE_SWIPE_UP : GESTURE_SWIPE_DOWN);
+	return G_IDLE;
+}
+
+static uint8_t G_Release(void)
+{
+	return G_IDLE;
+}
+
+static uint8_t G_Tapped_Tick(void)
+{
+	if (g_in->time - g_tap_t > g_cfg.double_tap_ms)
+		return G_IDLE;
+	return G_TAPPED;
+}
+
+typedef uint8_t (*G_Action)(void);
+
+static const G_Action g_table[G_STATES][G_INPUTS] = {
+	/*              DOWN     MOVE            UP            TICK */
+	/* IDLE    */ {G_Press, G_Stay, G_Stay, G_Stay},
+	/* PRESSED */ {G_Stay, G_Pressed_Move, G_Pressed_Up, G_Pressed_Tick},
+	/* HELD    */ {G_Stay, G_Stay, G_Release, G_Stay},
+	/* SWIPING */ {G_Stay, G_Swiping_Move, G_Swiping_Up, G_Stay},
+	/* TAPPED  */ {G_Press, G_Stay, G_Stay, G_Tapped_Tick},
+};
+
+static uint8_t G_Run(uint8_t input, const Touch_EventTypeDef *ev, Gesture_EventTypeDef *out)
+{
+	out->type = GESTURE_NONE;
+	g_in = ev;
+	g_out = out;
+	g_state = g_table[g_state][input]();
+	return out->type != GESTURE_NONE;
+}
+
+/************************************************
+** Gesture_Init :
+** Reset the recognizer, config may be NULL to
+** keep the current thresholds
+************************************************/
+void Gesture_Init(const Gesture_ConfigTypeDef *config)
+{
+	if (config)
+		g_cfg = *config;
+	g_state = G_IDLE;
+}
+
+/************************************************
+** Gesture_Process :
+** Feed one touch event
+** Return 1 if a gesture was written to *out
+************************************************/
+uint8_t Gesture_Process(const Touch_EventTypeDef *ev, Gesture_EventTypeDef *out)
+{
+	if (ev->type > TOUCH_EVT_UP)
+		return 0;
+	return G_Run(ev->type, ev, out);
+}
+
+/************************************************
+** Gesture_Tick :
+** Advance timeouts when no events arrive
+** (long-press without samples, double-tap window)
+************************************************/
+uint8_t Gesture_Tick(uint32_t now, Gesture_EventTypeDef *out)
+{
+	Touch_EventTypeDef tick;
+	tick.type = G_IN_TICK;
+	tick.x = g_x;
+	tick.y = g_y;
+	tick.z = 0xFFFF;
+	tick.time = now;
+	return G_Run(G_IN_TICK, &tick, out);
+}
+
+/************************************************
+** Hit_Build :
+** Bucket widgets into HIT_CELL x HIT_CELL cells
+** At most HIT_MAX_WIDGETS widgets are indexed
+************************************************/
+void Hit_Build(Hit_IndexTypeDef *index, const Hit_WidgetTypeDef *widget, uint8_t count)
+{
+	uint8_t i, r, c;
+	uint8_t r0, r1, c0, c1;
+
+	if (count > HIT_MAX_WIDGETS)
+		count = HIT_MAX_WIDGETS;
+	index->widget = widget;
+	index->count = count;
+	for (r = 0; r < HIT_ROWS; r++)
+		for (c = 0; c < HIT_COLS; c++)
+			index->cell[r][c] = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		c0 = widget[i].x0 / HIT_CELL;
+		c1 = widget[i].x1 / HIT_CELL;
+		r0 = widget[i].y0 / HIT_CELL;
+		r1 = widget[i].y1 / HIT_CELL;
+		if (c1 >= HIT_COLS)
+			c1 = HIT_COLS - 1;
+		if (r1 >= HIT_ROWS)
+			r1 = HIT_ROWS - 1;
+		for (r = r0; r <= r1; r++)
+			for (c = c0; c <= c1; c++)
+				index->cell[r][c] |= 1UL << i;
+	}
+}
+
+/************************************************
+** Hit_Test :
+** Return the id of the widget under (x, y),
+** -1 if none. Only widgets sharing the cell
+** are compared
+************************************************/
+int16_t Hit_Test(const Hit_IndexTypeDef *index, uint16_t x, uint16_t y)
+{
+	uint32_t mask;
+	uint8_t i;
+	const Hit_WidgetTypeDef *w;
+
+	if (x >= HIT_COLS * HIT_CELL || y >= HIT_ROWS * HIT_CELL)
+		return -1;
+	mask = index->cell[y / HIT_CELL][x / HIT_CELL];
+	for (i = 0; mask; i++, mask >>= 1)
+	{
+		if (!(mask & 1))
+			continue;
+		w = &index->widget[i];
+		if (x >= w->x0 && x <= w->x1 && y >= w->y0 && y <= w->y1)
+			return w->id;
+	}
+	return -1;
+}
@@ -0,0 +1,59 @@
+#ifndef __GESTURE_H__
+#define __GESTURE_H__
+
+#include "touch.h"
+
+/* Gesture types */
+#define GESTURE_NONE 0
+#define GESTURE_TAP 1
+#define GESTURE_DOUBLE_TAP 2
+#define GESTURE_LONG_PRESS 3
+#define GESTURE_SWIPE_LEFT 4
+#define GESTURE_SWIPE_RIGHT 5
+#define GESTURE_SWIPE_UP 6
+#define GESTURE_SWIPE_DOWN 7
+
+typedef struct
+{
+	uint16_t long_press_ms; // Hold time for a long-press
+	uint16_t double_tap_ms; // Max gap between two taps
+	uint16_t move_tol;		// Movement still counted as a press (px)
+	uint16_t swipe_min;		// Minimum travel for a swipe (px)
+} Gesture_ConfigTypeDef;
+
+typedef struct
+{
+	uint8_t type;  // GESTURE_xxx
+	uint16_t x;	   // Press position (screen)
+	uint16_t y;
+	uint32_t time; // Sampler clock of the deciding event (ms)
+} Gesture_EventTypeDef;
+
+/* Hit-testing index : widgets bucketed on a coarse screen grid */
+#define HIT_CELL 40
+#define HIT_COLS (240 / HIT_CELL)
+#define HIT_ROWS (320 / HIT_CELL)
+#define HIT_MAX_WIDGETS 32
+
+typedef struct
+{
+	uint16_t x0, y0; // Inclusive bounds
+	uint16_t x1, y1;
+	uint8_t id;
+} Hit_WidgetTypeDef;
+
+typedef struct
+{
+	const Hit_WidgetTypeDef *widget;
+	uint8_t count;
+	uint32_t cell[HIT_ROWS][HIT_COLS]; // Bit n set : widget n overlaps the cell
+} Hit_IndexTypeDef;
+
+void Gesture_Init(const Gesture_ConfigTypeDef *config);
+uint8_t Gesture_Process(const Touch_EventTypeDef *ev, Gesture_EventTypeDef *out);
+uint8_t Gesture_Tick(uint32_t now, Gesture_EventTypeDef *out);
+
+void Hit_Build(Hit_IndexTypeDef *index, const Hit_WidgetTypeDef *widget, uint8_t count);
+int16_t Hit_Test(const Hit_IndexTypeDef *index, uint16_t x, uint16_t y);
+
+#endif
@@ -10,12 +10,28 @@
 
 uint16_t DeviceCode;
 
+// PC8 is LCD_CS and T_CS. The touch sampler (TIM3) skips its tick while a
+// bus cycle is open and is re-triggered when the cycle ends
+volatile uint8_t LCD_Bus_Busy = 0;
+volatile uint8_t LCD_Bus_Deferred = 0;
+
 /* Private typedef -----------------------------------------------------------*/
 
 /* private function---------------------------------------------------------- */
 
+static void LCD_Bus_Release(void)
+{
+	LCD_Bus_Busy = 0;
+	if (LCD_Bus_Deferred)
+	{
+		LCD_Bus_Deferred = 0;
+		NVIC_SetPendingIRQ(TIM3_IRQn);
+	}
+}
+
 static void LCD_WR_REG(uint16_t LCD_Reg)
 {
+	LCD_Bus_Busy = 1;
 	GPIO_ResetBits(GPIOC, GPIO_Pin_8);
 	GPIO_ResetBits(GPIOD, GPIO_Pin_13);
 	GPIO_SetBits(GPIOD, GPIO_Pin_15);
@@ -26,10 +42,12 @@ static void LCD_WR_REG(uint16_t LCD_Reg)
 	GPIO_SetBits(GPIOB, GPIO_Pin_14);
 
 	GPIO_SetBits(GPIOC, GPIO_Pin_8);
+	LCD_Bus_Release();
 }
 
 static void LCD_WR_DATA(uint16_t LCD_Data)
 {
+	LCD_Bus_Busy = 1;
 	GPIO_ResetBits(GPIOC, GPIO_Pin_8);
 	GPIO_SetBits(GPIOD, GPIO_Pin_13);
 	GPIO_SetBits(GPIOD, GPIO_Pin_15);
@@ -40,6 +58,7 @@ static void LCD_WR_DATA(uint16_t LCD_Data)
 	GPIO_SetBits(GPIOB, GPIO_Pin_14);
 
 	GPIO_SetBits(GPIOC, GPIO_Pin_8);
+	LCD_Bus_Release();
 }
 
 static uint16_t LCD_ReadReg(uint16_t LCD_Reg)
@@ -55,12 +74,14 @@ static uint16_t LCD_ReadReg(uint16_t LCD_Reg)
 	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
 	GPIO_Init(GPIOE, &GPIO_InitStructure);
 
+	LCD_Bus_Busy = 1;
 	GPIO_ResetBits(GPIOC, GPIO_Pin_8);  // LCD_CS(0);
 	GPIO_SetBits(GPIOD, GPIO_Pin_13);   // LCD_RS(1);
 	GPIO_ResetBits(GPIOD, GPIO_Pin_15); // LCD_RD(0);
 	temp = GPIO_ReadInputData(GPIOE);
 	GPIO_SetBits(GPIOD, GPIO_Pin_15); // LCD_RD(1);
 	GPIO_SetBits(GPIOC, GPIO_Pin_8);  // LCD_CS(1);
+	LCD_Bus_Release();
 
 	// Read Done, Reset
 	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_All;
@@ -24,6 +24,11 @@
 #define GRAY 0X8430
 #define LGRAY 0XC618
 
+/* Set while LCD_CS (PC8, shared with T_CS) is low; a touch tick that lands
+   inside a bus cycle sets LCD_Bus_Deferred and runs when the cycle ends */
+extern volatile uint8_t LCD_Bus_Busy;
+extern volatile uint8_t LCD_Bus_Deferred;
+
 void LCD_Init(void);
 void LCD_Clear(uint16_t Color);
 void LCD_Fill(uint8_t xsta, uint16_t ysta, uint8_t xend, uint16_t yend, uint16_t colour);
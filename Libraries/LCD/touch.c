@@ -2,10 +2,13 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
+#ifndef TOUCH_HOST
 #include "stm32f10x.h"
 #include "stm32f10x_rcc.h"
 #include "lcd.h"
+#endif
 
 /************************************
 ** ADS_Write_Byte :
@@ -36,11 +39,11 @@ void ADS_Write_Byte(uint8_t num)
 }
 
 /************************************
-** ADS_Read_AD :
-** SPI Reading
+** ADS_BB_Read_AD :
+** SPI Reading (bit-bang backend)
 ** Read adc value  
 ************************************/
-uint16_t ADS_Read_AD(uint8_t CMD)
+static uint16_t ADS_BB_Read_AD(uint8_t CMD)
 {
 	uint8_t i;
 	uint8_t count = 0;
@@ -75,40 +78,601 @@ uint16_t ADS_Read_AD(uint8_t CMD)
 	return (Num);
 }
 
+static void ADS_BB_Read_Burst(uint8_t CMD, uint16_t *buf, uint8_t n)
+{
+	uint8_t i;
+	for (i = 0; i < n; i++)
+		buf[i] = ADS_BB_Read_AD(CMD);
+}
+
+#ifndef TOUCH_HOST
 /************************************************************************
-** #define : Read a coordinate
-** Read data for READ_TIMES times and sort them by ascending order
-** Then get rid of the highest and lowest LOST_VAL data and get the mean
+** SPI3 backend :
+** SPI3 remapped onto PC10(SCK) / PC11(MISO) / PC12(MOSI)
+** One conversion = command byte + 2 bytes, 12-bit result in bits 14..3
+** Bursts of several conversions run on DMA2 Ch1(RX) / Ch2(TX); the CPU
+** polls the RX transfer-complete flag meanwhile (24 SPI clocks, ~11us per
+** conversion at 2.25MHz), the gain over bit-bang is the shorter wait
+** Measure either backend on the target with Touch_Benchmark (UART
+** command TOUCH BENCH)
 ************************************************************************/
-#define READ_TIMES 15 // Number of times for reading
-#define LOST_VAL 5	// Number of data for discarding
-uint16_t ADS_Read_XY(uint8_t xy)
+#define ADS_SPI SPI3
+#define ADS_DMA_RX DMA2_Channel1
+#define ADS_DMA_TX DMA2_Channel2
+#define ADS_BURST_MAX 15
+
+static uint8_t ads_tx[ADS_BURST_MAX * 3];
+static uint8_t ads_rx[ADS_BURST_MAX * 3];
+
+static uint8_t ADS_SPI_Transfer(uint8_t data)
 {
-	uint16_t i, j;
-	uint16_t buf[READ_TIMES];
-	uint16_t sum = 0;
-	uint16_t temp;
-	for (i = 0; i < READ_TIMES; i++)
+	while (SPI_I2S_GetFlagStatus(ADS_SPI, SPI_I2S_FLAG_TXE) == RESET)
+		;
+	SPI_I2S_SendData(ADS_SPI, data);
+	while (SPI_I2S_GetFlagStatus(ADS_SPI, SPI_I2S_FLAG_RXNE) == RESET)
+		;
+	return SPI_I2S_ReceiveData(ADS_SPI);
+}
+
+static uint16_t ADS_SPI_Read_AD(uint8_t CMD)
+{
+	uint16_t Num;
+	T_CS_L;
+	ADS_SPI_Transfer(CMD);
+	Num = ADS_SPI_Transfer(0x00) << 8;
+	Num |= ADS_SPI_Transfer(0x00);
+	T_CS_H;
+	return (Num >> 3) & 0x0FFF;
+}
+
+static void ADS_SPI_Read_Burst(uint8_t CMD, uint16_t *buf, uint8_t n)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	uint8_t i;
+
+	if (n < 2)
 	{
-		buf[i] = ADS_Read_AD(xy);
+		if (n)
+			buf[0] = ADS_SPI_Read_AD(CMD);
+		return;
+	}
+	if (n > ADS_BURST_MAX)
+		n = ADS_BURST_MAX;
+
+	for (i = 0; i < n; i++)
+	{
+		ads_tx[i * 3] = CMD;
+		ads_tx[i * 3 + 1] = 0x00;
+		ads_tx[i * 3 + 2] = 0x00;
+	}
+
+	DMA_DeInit(ADS_DMA_RX);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&ADS_SPI->DR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ads_rx;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_BufferSize = n * 3;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(ADS_DMA_RX, &DMA_InitStructure);
+
+	DMA_DeInit(ADS_DMA_TX);
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ads_tx;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+	DMA_Init(ADS_DMA_TX, &DMA_InitStructure);
+
+	T_CS_L;
+	DMA_Cmd(ADS_DMA_RX, ENABLE);
+	DMA_Cmd(ADS_DMA_TX, ENABLE);
+	SPI_I2S_DMACmd(ADS_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+
+	while (DMA_GetFlagStatus(DMA2_FLAG_TC1) == RESET) // Busy wait, a burst is a few tens of us
+		;
+
+	SPI_I2S_DMACmd(ADS_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+	DMA_Cmd(ADS_DMA_TX, DISABLE);
+	DMA_Cmd(ADS_DMA_RX, DISABLE);
+	T_CS_H;
+
+	for (i = 0; i < n; i++)
+		buf[i] = (((uint16_t)ads_rx[i * 3 + 1] << 8 | ads_rx[i * 3 + 2]) >> 3) & 0x0FFF;
+}
+#endif /* TOUCH_HOST */
+
+/************************************************************************
+** Capture :
+** While enabled, each sampler tick is appended to a byte ring buffer as
+** one frame [0xA5] [len] [type] [time lo] [time hi] payload.. [check]
+** (len = whole frame, time = tick time low 16 bits,
+**  check = ~(sum of len .. last payload byte))
+**   0xB0 calibration : xfac yfac xoff yoff (12 bytes, little endian),
+**                      first frame after Touch_Capture_Start
+**   0xE0 | pen  tick : runs of conversions, each run one byte
+**                      cmd[7:4] | count[3:0] followed by the 12-bit values
+**                      packed two per 3 bytes (an odd last one in 2)
+**   0xC0   pen-up run: [count], ticks without conversions (up to 255)
+**   0xF0        drop : [lost lo] [lost hi], ticks lost to a full ring
+** A pen-down tick of 4 x TOUCH_TICK_READS conversions is 30 bytes, about
+** 3 kB/s against 960 B/s for the 9600 baud link, so the ring holds about
+** 2 s of continuous pen-down; longer strokes show up as drop frames.
+** Conversions outside sampler ticks (synchronous reads) are not captured.
+** The stream shares the UART with text, so the replayer resyncs on the
+** sync byte and check; Touch_Capture_Read only hands out whole frames.
+************************************************************************/
+#define TOUCH_CAP_SIZE 4096 // Power of 2
+#define TOUCH_CAP_SYNC 0xA5
+#define TOUCH_CAP_CONV 16		// Conversions kept per tick
+#define TOUCH_CAP_CAL 0xB0
+#define TOUCH_CAP_IDLE 0xC0
+#define TOUCH_CAP_TICK 0xE0
+#define TOUCH_CAP_DROP 0xF0
+
+static uint8_t touch_cap[TOUCH_CAP_SIZE];
+static volatile uint16_t touch_cap_head = 0;
+static volatile uint16_t touch_cap_tail = 0;
+static uint16_t touch_cap_lost = 0;	 // Ticks lost since the last drop frame
+static uint8_t touch_cap_idle = 0;	 // Pen-up ticks not written yet
+static uint16_t touch_cap_idle_time; // Time of the last of them
+static volatile uint32_t touch_cap_frames = 0;
+static volatile uint32_t touch_cap_dropped = 0;
+static volatile uint8_t touch_capture = 0;
+
+// Tick being recorded
+static uint8_t touch_cap_open = 0;
+static uint8_t touch_cap_pen;
+static uint16_t touch_cap_time;
+static uint8_t touch_cap_n;
+static uint8_t touch_cap_cmd[TOUCH_CAP_CONV];
+static uint16_t touch_cap_val[TOUCH_CAP_CONV];
+
+static uint8_t Touch_Capture_Head(uint8_t *f, uint8_t type, uint16_t time)
+{
+	f[0] = TOUCH_CAP_SYNC;
+	f[2] = type;
+	f[3] = time & 0xFF;
+	f[4] = time >> 8;
+	return 5;
+}
+
+// Fill in len and check, return the frame length
+static uint8_t Touch_Capture_Seal(uint8_t *f, uint8_t len)
+{
+	uint8_t check = 0;
+	uint8_t i;
+
+	f[1] = len + 1;
+	for (i = 1; i < len; i++)
+		check += f[i];
+	f[len] = ~check;
+	return len + 1;
+}
+
+// Copy a frame into the ring and publish it with one head update
+static uint8_t Touch_Capture_Write(const uint8_t *f, uint8_t len)
+{
+	uint16_t h = touch_cap_head;
+	uint16_t used = (h - touch_cap_tail) & (TOUCH_CAP_SIZE - 1);
+	uint8_t i;
+
+	if (TOUCH_CAP_SIZE - 1 - used < len)
+		return 0;
+	for (i = 0; i < len; i++)
+	{
+		touch_cap[h] = f[i];
+		h = (h + 1) & (TOUCH_CAP_SIZE - 1);
+	}
+	touch_cap_head = h;
+	return 1;
+}
+
+static uint8_t Touch_Capture_Pack(uint8_t *f)
+{
+	uint8_t len = Touch_Capture_Head(f, TOUCH_CAP_TICK | touch_cap_pen, touch_cap_time);
+	uint8_t i, k, run;
+	uint16_t a, b;
+
+	for (i = 0; i < touch_cap_n; i += run)
+	{
+		for (run = 1; i + run < touch_cap_n && run < 15 && touch_cap_cmd[i + run] == touch_cap_cmd[i]; run++)
+			;
+		f[len++] = touch_cap_cmd[i] | run;
+		for (k = 0; k + 1 < run; k += 2)
+		{
+			a = touch_cap_val[i + k];
+			b = touch_cap_val[i + k + 1];
+			f[len++] = a >> 4;
+			f[len++] = (a & 0x0F) << 4 | b >> 8;
+			f[len++] = b & 0xFF;
+		}
+		if (k < run)
+		{
+			a = touch_cap_val[i + k];
+			f[len++] = a >> 4;
+			f[len++] = (a & 0x0F) << 4;
+		}
+	}
+	return Touch_Capture_Seal(f, len);
+}
+
+// Write the pending pen-up run, if any
+static void Touch_Capture_Flush_Idle(void)
+{
+	uint8_t f[8];
+	uint8_t len;
+
+	if (!touch_cap_idle)
+		return;
+	len = Touch_Capture_Head(f, TOUCH_CAP_IDLE, touch_cap_idle_time);
+	f[len++] = touch_cap_idle;
+	if (Touch_Capture_Write(f, Touch_Capture_Seal(f, len)))
+	{
+		touch_cap_frames += touch_cap_idle;
+	}
+	else
+	{
+		touch_cap_lost += touch_cap_idle;
+		touch_cap_dropped += touch_cap_idle;
+	}
+	touch_cap_idle = 0;
+}
+
+static void Touch_Capture_Open(uint8_t pen)
+{
+	touch_cap_pen = pen;
+	touch_cap_time = (uint16_t)Touch_GetTime();
+	touch_cap_n = 0;
+	touch_cap_open = 1;
+}
+
+static void Touch_Capture_Close(void)
+{
+	uint8_t f[TOUCH_CAP_FRAME_MAX];
+	uint8_t len;
+
+	touch_cap_open = 0;
+	if (!touch_cap_pen && !touch_cap_n) // Pen up: counted, written as one run
+	{
+		touch_cap_idle_time = touch_cap_time;
+		if (++touch_cap_idle == 255)
+			Touch_Capture_Flush_Idle();
+		return;
+	}
+
+	Touch_Capture_Flush_Idle();
+	if (touch_cap_lost)
+	{
+		len = Touch_Capture_Head(f, TOUCH_CAP_DROP, touch_cap_time);
+		f[len++] = touch_cap_lost & 0xFF;
+		f[len++] = touch_cap_lost >> 8;
+		if (Touch_Capture_Write(f, Touch_Capture_Seal(f, len)))
+			touch_cap_lost = 0;
+	}
+	if (!touch_cap_lost && Touch_Capture_Write(f, Touch_Capture_Pack(f)))
+	{
+		touch_cap_frames++;
+	}
+	else
+	{
+		touch_cap_lost++;
+		touch_cap_dropped++;
+	}
+}
+
+static void Touch_Capture_Put(uint8_t CMD, uint16_t Num)
+{
+	if (!touch_cap_open || touch_cap_n >= TOUCH_CAP_CONV)
+		return;
+	touch_cap_cmd[touch_cap_n] = CMD & 0xF0;
+	touch_cap_val[touch_cap_n] = Num & 0x0FFF;
+	touch_cap_n++;
+}
+
+void Touch_Capture_Start(void)
+{
+	uint8_t f[20];
+	uint8_t len;
+
+	touch_capture = 0;
+	touch_cap_open = 0;
+	touch_cap_tail = touch_cap_head;
+	touch_cap_lost = 0;
+	touch_cap_idle = 0;
+	touch_cap_frames = 0;
+	touch_cap_dropped = 0;
+
+	len = Touch_Capture_Head(f, TOUCH_CAP_CAL, (uint16_t)Touch_GetTime());
+	memcpy(&f[len], &xfac, 4);
+	memcpy(&f[len + 4], &yfac, 4);
+	len += 8;
+	f[len++] = (uint16_t)xoff & 0xFF;
+	f[len++] = (uint16_t)xoff >> 8;
+	f[len++] = (uint16_t)yoff & 0xFF;
+	f[len++] = (uint16_t)yoff >> 8;
+	Touch_Capture_Write(f, Touch_Capture_Seal(f, len)); // Ring is empty
+
+	touch_capture = 1;
+}
+
+void Touch_Capture_Stop(void)
+{
+	touch_capture = 0;
+}
+
+/************************************************
+** Touch_Capture_Stats :
+** Ticks captured and ticks dropped (ring full)
+** since Touch_Capture_Start
+************************************************/
+void Touch_Capture_Stats(uint32_t *frames, uint32_t *dropped)
+{
+	*frames = touch_cap_frames;
+	*dropped = touch_cap_dropped;
+}
+
+/************************************************
+** Touch_Capture_Read :
+** Copy captured frames into buf while they fit,
+** whole frames only (text sent in between can
+** never split a frame); max should be at least
+** TOUCH_CAP_FRAME_MAX
+** Return the number of bytes copied
+************************************************/
+uint16_t Touch_Capture_Read(uint8_t *buf, uint16_t max)
+{
+	uint16_t n = 0;
+	uint8_t len, i;
+
+	while (touch_cap_tail != touch_cap_head)
+	{
+		len = touch_cap[(touch_cap_tail + 1) & (TOUCH_CAP_SIZE - 1)];
+		if (n + len > max)
+			break;
+		for (i = 0; i < len; i++)
+		{
+			buf[n++] = touch_cap[touch_cap_tail];
+			touch_cap_tail = (touch_cap_tail + 1) & (TOUCH_CAP_SIZE - 1);
+		}
+	}
+	return n;
+}
+
+/* Active backend, selected by Touch_Transport_Init */
+static uint16_t (*ads_read_ad)(uint8_t CMD) = ADS_BB_Read_AD;
+static void (*ads_read_burst)(uint8_t CMD, uint16_t *buf, uint8_t n) = ADS_BB_Read_Burst;
+static uint8_t ads_transport = TOUCH_TRANSPORT_BITBANG;
+
+/************************************
+** ADS_Read_AD :
+** Read adc value on active backend
+************************************/
+uint16_t ADS_Read_AD(uint8_t CMD)
+{
+	uint16_t Num = ads_read_ad(CMD);
+	Touch_Capture_Put(CMD, Num);
+	return Num;
+}
+
+/************************************
+** ADS_Read_Burst :
+** Read n adc values back to back
+************************************/
+void ADS_Read_Burst(uint8_t CMD, uint16_t *buf, uint8_t n)
+{
+	uint8_t i;
+	ads_read_burst(CMD, buf, n);
+	for (i = 0; i < n; i++)
+		Touch_Capture_Put(CMD, buf[i]);
+}
+
+/************************************************
+** Touch_Transport_Custom :
+** Install an external backend (replay, test)
+************************************************/
+void Touch_Transport_Custom(uint16_t (*read_ad)(uint8_t CMD),
+							void (*read_burst)(uint8_t CMD, uint16_t *buf, uint8_t n))
+{
+	ads_read_ad = read_ad;
+	ads_read_burst = read_burst;
+	ads_transport = TOUCH_TRANSPORT_CUSTOM;
+}
+
+#ifndef TOUCH_HOST
+
+/************************************************
+** Touch_Transport_Init :
+** Select the SPI transport for the ADS7843
+** TOUCH_TRANSPORT_SPI3 falls back to bit-bang
+** on any other value
+************************************************/
+void Touch_Transport_Init(uint8_t transport)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+	SPI_InitTypeDef SPI_InitStructure;
+
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+
+	if (transport == TOUCH_TRANSPORT_SPI3)
+	{
+		RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOC | RCC_APB2Periph_AFIO, ENABLE);
+		RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI3, ENABLE);
+		RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA2, ENABLE);
+		GPIO_PinRemapConfig(GPIO_Remap_SPI3, ENABLE);
+
+		GPIO_InitStructure.GPIO_Pin = GPIO_Pin_10 | GPIO_Pin_12;
+		GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+		GPIO_Init(GPIOC, &GPIO_InitStructure);
+		GPIO_InitStructure.GPIO_Pin = GPIO_Pin_11;
+		GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
+		GPIO_Init(GPIOC, &GPIO_InitStructure);
+
+		SPI_InitStructure.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
+		SPI_InitStructure.SPI_Mode = SPI_Mode_Master;
+		SPI_InitStructure.SPI_DataSize = SPI_DataSize_8b;
+		SPI_InitStructure.SPI_CPOL = SPI_CPOL_Low;
+		SPI_InitStructure.SPI_CPHA = SPI_CPHA_1Edge;
+		SPI_InitStructure.SPI_NSS = SPI_NSS_Soft;
+		SPI_InitStructure.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_16; // 36MHz / 16 = 2.25MHz
+		SPI_InitStructure.SPI_FirstBit = SPI_FirstBit_MSB;
+		SPI_InitStructure.SPI_CRCPolynomial = 7;
+		SPI_Init(ADS_SPI, &SPI_InitStructure);
+		SPI_Cmd(ADS_SPI, ENABLE);
+
+		ads_read_ad = ADS_SPI_Read_AD;
+		ads_read_burst = ADS_SPI_Read_Burst;
+		ads_transport = TOUCH_TRANSPORT_SPI3;
+	}
+	else
+	{
+		SPI_Cmd(ADS_SPI, DISABLE);
+		GPIO_PinRemapConfig(GPIO_Remap_SPI3, DISABLE);
+
+		GPIO_InitStructure.GPIO_Pin = GPIO_Pin_10 | GPIO_Pin_12;
+		GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+		GPIO_InitStructure.GPIO_Speed = GPIO_Speed_10MHz;
+		GPIO_Init(GPIOC, &GPIO_InitStructure);
+		GPIO_InitStructure.GPIO_Pin = GPIO_Pin_11;
+		GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
+		GPIO_Init(GPIOC, &GPIO_InitStructure);
+
+		ads_read_ad = ADS_BB_Read_AD;
+		ads_read_burst = ADS_BB_Read_Burst;
+		ads_transport = TOUCH_TRANSPORT_BITBANG;
+	}
+}
+
+/************************************************
+** Touch_Benchmark :
+** Measure conversions per second of a backend
+** with the DWT cycle counter
+** The previously active backend is restored
+************************************************/
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+
+uint32_t Touch_Benchmark(uint8_t transport, uint16_t samples)
+{
+	uint16_t buf[ADS_BURST_MAX];
+	uint16_t done = 0;
+	uint8_t n;
+	uint8_t prev = ads_transport;
+	uint32_t start, cycles;
+
+	Touch_Transport_Init(transport);
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT_CTRL |= 1; // CYCCNTENA
+
+	start = DWT_CYCCNT;
+	while (done < samples)
+	{
+		n = (samples - done > ADS_BURST_MAX) ? ADS_BURST_MAX : samples - done;
+		ADS_Read_Burst(0xd0, buf, n);
+		done += n;
 	}
-	for (i = 0; i < READ_TIMES - 1; i++)
+	cycles = DWT_CYCCNT - start;
+
+	Touch_Transport_Init(prev);
+
+	if (cycles == 0)
+		return 0;
+	return (uint32_t)((uint64_t)samples * SystemCoreClock / cycles);
+}
+#endif /* TOUCH_HOST */
+
+/************************************************************************
+** #define : Read a coordinate
+** Sample until ADS_STABLE_RUN consecutive readings agree within
+** ADS_STABLE_TOL and return their mean (early exit)
+** Otherwise read READ_TIMES samples, get rid of the highest and lowest
+** LOST_VAL data by partial selection and get the mean of the rest
+************************************************************************/
+#define READ_TIMES 15	  // Number of times for reading
+#define LOST_VAL 5		  // Number of data for discarding
+#define ADS_STABLE_RUN 3  // Consecutive samples needed for early exit
+#define ADS_STABLE_TOL 8  // Max spread of a stable run (ADC counts)
+
+/************************************************
+** ADS_Select :
+** Partial selection (nth_element)
+** Reorder buf[lo..hi] so that buf[k] holds the
+** k-th smallest value, with no larger value on
+** its left and no smaller value on its right
+************************************************/
+static void ADS_Select(uint16_t *buf, int16_t lo, int16_t hi, int16_t k)
+{
+	int16_t i, j;
+	uint16_t pivot;
+	uint16_t temp;
+
+	while (lo < hi)
 	{
-		for (j = i + 1; j < READ_TIMES; j++)
+		pivot = buf[(lo + hi) >> 1];
+		i = lo;
+		j = hi;
+		while (i <= j)
 		{
-			if (buf[i] > buf[j])
+			while (buf[i] < pivot)
+				i++;
+			while (buf[j] > pivot)
+				j--;
+			if (i <= j)
 			{
 				temp = buf[i];
 				buf[i] = buf[j];
 				buf[j] = temp;
+				i++;
+				j--;
 			}
 		}
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			return; // buf[j+1..i-1] all equal the pivot
+	}
+}
+
+uint16_t ADS_Read_XY(uint8_t xy)
+{
+	uint16_t i, j;
+	uint16_t buf[READ_TIMES];
+	uint16_t min, max;
+	uint32_t sum;
+
+	ADS_Read_Burst(xy, buf, ADS_STABLE_RUN - 1);
+	for (i = ADS_STABLE_RUN - 1; i < READ_TIMES; i++)
+	{
+		buf[i] = ADS_Read_AD(xy);
+
+		min = max = buf[i];
+		sum = 0;
+		for (j = i + 1 - ADS_STABLE_RUN; j <= i; j++)
+		{
+			if (buf[j] < min)
+				min = buf[j];
+			if (buf[j] > max)
+				max = buf[j];
+			sum += buf[j];
+		}
+		if (max - min <= ADS_STABLE_TOL)
+			return sum / ADS_STABLE_RUN;
 	}
+
+	/* Middle READ_TIMES - 2 * LOST_VAL values end up in
+	   buf[LOST_VAL .. READ_TIMES - LOST_VAL - 1] (unordered) */
+	ADS_Select(buf, 0, READ_TIMES - 1, LOST_VAL);
+	ADS_Select(buf, LOST_VAL + 1, READ_TIMES - 1, READ_TIMES - LOST_VAL - 1);
+
 	sum = 0;
 	for (i = LOST_VAL; i < READ_TIMES - LOST_VAL; i++)
 		sum += buf[i];
-	temp = sum / (READ_TIMES - 2 * LOST_VAL);
-	return temp;
+	return sum / (READ_TIMES - 2 * LOST_VAL);
 }
 
 /********************************************
@@ -235,6 +799,18 @@ void Touch_GetXY(uint16_t *x, uint16_t *y, uint8_t ext)
 	}
 }
 
+void Convert_Pos(u16 x_in, u16 y_in, u16 *x_out, u16 *y_out)
+{
+	*x_out = xfac * x_in + xoff;
+	*y_out = yfac * y_in + yoff;
+}
+
+float xfac;
+float yfac;
+short xoff;
+short yoff;
+
+#ifndef TOUCH_HOST
 /* Touch_Configuration */
 void Touch_Configuration()
 {
@@ -242,11 +818,17 @@ void Touch_Configuration()
 
 	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOC | RCC_APB2Periph_GPIOB, ENABLE);
 
-	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_12 | GPIO_Pin_10 | GPIO_Pin_9;
+	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_12 | GPIO_Pin_10;
 	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
 	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_10MHz;
 	GPIO_Init(GPIOC, &GPIO_InitStructure);
 
+	/* T_CS : PC8, shared with LCD_CS, same mode as LCD_Configuration */
+	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_Init(GPIOC, &GPIO_InitStructure);
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_10MHz;
+
 	GPIO_InitStructure.GPIO_Pin = GPIO_Pin_11;
 	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
 	GPIO_Init(GPIOC, &GPIO_InitStructure);
@@ -280,17 +862,6 @@ void Refreshes_Screen(void)
 	LCD_Clear(WHITE);
 }
 
-void Convert_Pos(u16 x_in, u16 y_in, u16 *x_out, u16 *y_out)
-{
-	*x_out = xfac * x_in + xoff;
-	*y_out = yfac * y_in + yoff;
-}
-
-float xfac;
-float yfac;
-short xoff;
-short yoff;
-
 /************************************************
 ** Touch_Adjust :
 ** Code for touch screen calibration
@@ -395,3 +966,326 @@ void Touch_Adjust(void)
 		break;
 	}
 }
+
+/************************************************************************
+** Calibration storage :
+** xfac / yfac / xoff / yoff are kept in backup registers BKP_DR2..DR9
+** (magic, 2 words per float, 1 word per offset, CRC-16/CCITT) so they
+** survive reset while VBAT is present
+************************************************************************/
+#define TOUCH_CAL_MAGIC 0x7C41
+#define TOUCH_CAL_WORDS 7 // Words covered by the CRC (magic .. yoff)
+
+static const uint16_t touch_cal_reg[TOUCH_CAL_WORDS + 1] = {
+	BKP_DR2, BKP_DR3, BKP_DR4, BKP_DR5, BKP_DR6, BKP_DR7, BKP_DR8, BKP_DR9};
+
+static uint16_t Touch_Cal_CRC(const uint16_t *data, uint8_t len)
+{
+	uint16_t crc = 0xFFFF;
+	uint8_t i, bit;
+	for (i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for (bit = 0; bit < 16; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	}
+	return crc;
+}
+
+static void Touch_Cal_Pack(uint16_t *data)
+{
+	union
+	{
+		float f;
+		uint32_t u;
+	} conv;
+
+	data[0] = TOUCH_CAL_MAGIC;
+	conv.f = xfac;
+	data[1] = conv.u & 0xFFFF;
+	data[2] = conv.u >> 16;
+	conv.f = yfac;
+	data[3] = conv.u & 0xFFFF;
+	data[4] = conv.u >> 16;
+	data[5] = (uint16_t)xoff;
+	data[6] = (uint16_t)yoff;
+}
+
+static void Touch_Backup_Access(void)
+{
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR | RCC_APB1Periph_BKP, ENABLE);
+	PWR_BackupAccessCmd(ENABLE);
+}
+
+/************************************************
+** Touch_LoadCalibration :
+** Restore calibration from backup registers
+** Return 1 if magic and CRC are valid
+************************************************/
+uint8_t Touch_LoadCalibration(void)
+{
+	uint16_t data[TOUCH_CAL_WORDS + 1];
+	uint8_t i;
+	union
+	{
+		float f;
+		uint32_t u;
+	} conv;
+
+	Touch_Backup_Access();
+	for (i = 0; i < TOUCH_CAL_WORDS + 1; i++)
+		data[i] = BKP_ReadBackupRegister(touch_cal_reg[i]);
+
+	if (data[0] != TOUCH_CAL_MAGIC || Touch_Cal_CRC(data, TOUCH_CAL_WORDS) != data[TOUCH_CAL_WORDS])
+		return 0;
+
+	conv.u = data[1] | ((uint32_t)data[2] << 16);
+	xfac = conv.f;
+	conv.u = data[3] | ((uint32_t)data[4] << 16);
+	yfac = conv.f;
+	xoff = (short)data[5];
+	yoff = (short)data[6];
+	return 1;
+}
+
+/************************************************
+** Touch_SaveCalibration :
+** Store current calibration with its CRC
+************************************************/
+void Touch_SaveCalibration(void)
+{
+	uint16_t data[TOUCH_CAL_WORDS + 1];
+	uint8_t i;
+
+	Touch_Cal_Pack(data);
+	data[TOUCH_CAL_WORDS] = Touch_Cal_CRC(data, TOUCH_CAL_WORDS);
+
+	Touch_Backup_Access();
+	for (i = 0; i < TOUCH_CAL_WORDS + 1; i++)
+		BKP_WriteBackupRegister(touch_cal_reg[i], data[i]);
+}
+
+/************************************************
+** Touch_Init :
+** Configure pins and restore calibration
+** Touch_Adjust only runs when the stored data is
+** missing / corrupted or recalibrate is set
+************************************************/
+void Touch_Init(uint8_t recalibrate)
+{
+	Touch_Configuration();
+	if (recalibrate || !Touch_LoadCalibration())
+	{
+		Touch_Adjust();
+		Touch_SaveCalibration();
+	}
+}
+#endif /* TOUCH_HOST */
+
+/************************************************************************
+** Background sampler :
+** TIM3 fires every TOUCH_SAMPLE_MS while running. On each tick with the
+** pen down, X, Y, Z1 and Z2 are converted (median of TOUCH_TICK_READS
+** back-to-back conversions each, to keep the interrupt short; the
+** READ_TIMES filter is for the synchronous reads) and the touch resistance
+**   Rtouch = TOUCH_RX_PLATE * X / 4096 * (Z2 / Z1 - 1)
+** is computed. Light or sliding contacts (small Z1, large Rtouch) are
+** dropped; accepted samples are queued as DOWN / MOVE events in screen
+** coordinates and an UP event is queued when the pen is lifted
+************************************************************************/
+#define TOUCH_SAMPLE_MS 10	 // Sampling period (100Hz)
+#define TOUCH_RX_PLATE 400	 // X plate resistance (ohm)
+#define TOUCH_Z1_MIN 64		 // Minimum Z1 for a valid contact
+#define TOUCH_R_MAX 1500	 // Maximum touch resistance (ohm)
+#define TOUCH_EVT_SIZE 16	 // Event ring buffer size (power of 2)
+#define TOUCH_TICK_READS 3	 // Conversions per channel per tick (median, odd)
+
+static Touch_EventTypeDef touch_evt[TOUCH_EVT_SIZE];
+static volatile uint8_t touch_evt_head = 0;
+static volatile uint8_t touch_evt_tail = 0;
+static volatile uint32_t touch_ms = 0;
+static uint8_t touch_pen = 0;
+static uint16_t touch_last_x, touch_last_y;
+
+static void Touch_Push_Event(uint8_t type, uint16_t x, uint16_t y, uint16_t z)
+{
+	uint8_t next = (touch_evt_head + 1) & (TOUCH_EVT_SIZE - 1);
+	if (next == touch_evt_tail)
+		return; // Full, drop newest
+	touch_evt[touch_evt_head].type = type;
+	touch_evt[touch_evt_head].x = x;
+	touch_evt[touch_evt_head].y = y;
+	touch_evt[touch_evt_head].z = z;
+	touch_evt[touch_evt_head].time = touch_ms;
+	touch_evt_head = next;
+}
+
+/************************************************
+** Touch_Pressure :
+** Touch resistance in ohm from X, Z1 and Z2
+** Lower is firmer, 0xFFFF for no contact
+************************************************/
+uint16_t Touch_Pressure(uint16_t x, uint16_t z1, uint16_t z2)
+{
+	uint32_t r;
+	if (z1 < TOUCH_Z1_MIN || z2 <= z1)
+		return 0xFFFF;
+	// 400 / 4096 reduced to 100 / 1024 so the product fits 32 bits
+	r = (uint32_t)(TOUCH_RX_PLATE / 4) * x * (z2 - z1) / (1024UL * z1);
+	return (r > 0xFFFE) ? 0xFFFE : (uint16_t)r;
+}
+
+/* One filtered value per channel: median of a TOUCH_TICK_READS burst */
+static uint16_t Touch_Tick_Read(uint8_t CMD)
+{
+	uint16_t v[TOUCH_TICK_READS];
+	uint16_t t;
+	uint8_t i, j;
+
+	ADS_Read_Burst(CMD, v, TOUCH_TICK_READS);
+	for (i = 1; i < TOUCH_TICK_READS; i++) // Insertion sort, a handful of values
+	{
+		t = v[i];
+		for (j = i; j > 0 && v[j - 1] > t; j--)
+			v[j] = v[j - 1];
+		v[j] = t;
+	}
+	return v[TOUCH_TICK_READS / 2];
+}
+
+static void Touch_Sampler_Run(uint8_t up)
+{
+	uint16_t x, y, z1, z2, z;
+	uint16_t sx, sy;
+
+	if (up)
+	{
+		if (touch_pen)
+		{
+			touch_pen = 0;
+			Touch_Push_Event(TOUCH_EVT_UP, touch_last_x, touch_last_y, 0xFFFF);
+		}
+		return;
+	}
+
+	x = Touch_Tick_Read(0xd0);
+	y = Touch_Tick_Read(0x90);
+	z1 = Touch_Tick_Read(0xb0);
+	z2 = Touch_Tick_Read(0xc0);
+
+	z = Touch_Pressure(x, z1, z2);
+	if (x < 100 || y < 100 || z > TOUCH_R_MAX)
+		return; // Too light or sliding, wait for a firmer sample
+
+	Convert_Pos(x, y, &sx, &sy);
+	touch_last_x = sx;
+	touch_last_y = sy;
+	Touch_Push_Event(touch_pen ? TOUCH_EVT_MOVE : TOUCH_EVT_DOWN, sx, sy, z);
+	touch_pen = 1;
+}
+
+/************************************************
+** Touch_Sampler_Tick :
+** One sampling period, called from TIM3
+** (or by a replay harness on the host)
+************************************************/
+void Touch_Sampler_Tick(void)
+{
+	uint8_t up = T_INT;
+
+	touch_ms += TOUCH_SAMPLE_MS;
+	if (touch_capture)
+		Touch_Capture_Open(!up);
+	Touch_Sampler_Run(up);
+	if (touch_cap_open)
+		Touch_Capture_Close();
+}
+
+#ifndef TOUCH_HOST
+static volatile uint8_t touch_tick_due = 0;
+
+/************************************************
+** TIM3_IRQHandler :
+** T_CS is PC8, also LCD_CS. If the timer fires
+** inside an LCD bus cycle the tick is left due
+** and lcd.c pends TIM3 again once CS is released
+************************************************/
+void TIM3_IRQHandler(void)
+{
+	if (TIM_GetITStatus(TIM3, TIM_IT_Update) != RESET)
+	{
+		TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
+		touch_tick_due = 1;
+	}
+	if (!touch_tick_due)
+		return;
+	if (LCD_Bus_Busy)
+	{
+		LCD_Bus_Deferred = 1;
+		return;
+	}
+	touch_tick_due = 0;
+	Touch_Sampler_Tick();
+}
+
+/************************************************
+** Touch_Sampler_Start :
+** Start TIM3 driven sampling
+** Synchronous reads (Touch_GetXY, Touch_Adjust)
+** must not run while the sampler is started
+************************************************/
+void Touch_Sampler_Start(void)
+{
+	TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+
+	TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / 10000) - 1; // 10kHz
+	TIM_TimeBaseStructure.TIM_Period = TOUCH_SAMPLE_MS * 10 - 1;
+	TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(TIM3, &TIM_TimeBaseStructure);
+	TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
+	TIM_ITConfig(TIM3, TIM_IT_Update, ENABLE);
+
+	NVIC_InitStructure.NVIC_IRQChannel = TIM3_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 3;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&NVIC_InitStructure);
+
+	touch_pen = 0;
+	touch_tick_due = 0;
+	touch_evt_tail = touch_evt_head;
+	TIM_Cmd(TIM3, ENABLE);
+}
+
+void Touch_Sampler_Stop(void)
+{
+	TIM_Cmd(TIM3, DISABLE);
+	TIM_ITConfig(TIM3, TIM_IT_Update, DISABLE);
+	touch_tick_due = 0; // A deferred tick must not run after the stop
+}
+#endif /* TOUCH_HOST */
+
+/************************************************
+** Touch_GetEvent :
+** Pop one queued touch event
+** Return 1 if an event was copied to *ev
+************************************************/
+uint8_t Touch_GetEvent(Touch_EventTypeDef *ev)
+{
+	if (touch_evt_tail == touch_evt_head)
+		return 0;
+	*ev = touch_evt[touch_evt_tail];
+	touch_evt_tail = (touch_evt_tail + 1) & (TOUCH_EVT_SIZE - 1);
+	return 1;
+}
+
+/* Sampler clock in ms */
+uint32_t Touch_GetTime(void)
+{
+	return touch_ms;
+}
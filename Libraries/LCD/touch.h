@@ -23,8 +23,32 @@ extern short yoff;
 
 #define T_INT (1 & ((GPIOC->IDR) >> 5))
 
+/* ADS7843 transport backends */
+#define TOUCH_TRANSPORT_BITBANG 0
+#define TOUCH_TRANSPORT_SPI3 1
+#define TOUCH_TRANSPORT_CUSTOM 2
+
+/* Background sampler events */
+#define TOUCH_EVT_DOWN 0
+#define TOUCH_EVT_MOVE 1
+#define TOUCH_EVT_UP 2
+
+typedef struct
+{
+	uint8_t type;  // TOUCH_EVT_xxx
+	uint16_t x;	   // Screen coordinate
+	uint16_t y;
+	uint16_t z;	   // Touch resistance (ohm), lower is firmer
+	uint32_t time; // Sampler clock (ms)
+} Touch_EventTypeDef;
+
 void ADS_Write_Byte(uint8_t num);
 uint16_t ADS_Read_AD(uint8_t CMD);
+void ADS_Read_Burst(uint8_t CMD, uint16_t *buf, uint8_t n);
+void Touch_Transport_Init(uint8_t transport);
+void Touch_Transport_Custom(uint16_t (*read_ad)(uint8_t CMD),
+							void (*read_burst)(uint8_t CMD, uint16_t *buf, uint8_t n));
+uint32_t Touch_Benchmark(uint8_t transport, uint16_t samples);
 void Touch_Configuration(void);
 void Draw_Big_Point(u16 x, u16 y);
 uint8_t Touch_GexX(uint16_t *y, uint8_t ext);
@@ -33,4 +57,22 @@ void Touch_GetXY(uint16_t *x, uint16_t *y, uint8_t ext);
 void Touch_Adjust(void);
 void Convert_Pos(u16 x_in, u16 y_in, u16 *x_out, u16 *y_out);
 
+uint8_t Touch_LoadCalibration(void);
+void Touch_SaveCalibration(void);
+void Touch_Init(uint8_t recalibrate);
+
+uint16_t Touch_Pressure(uint16_t x, uint16_t z1, uint16_t z2);
+void Touch_Sampler_Start(void);
+void Touch_Sampler_Stop(void);
+void Touch_Sampler_Tick(void);
+uint8_t Touch_GetEvent(Touch_EventTypeDef *ev);
+uint32_t Touch_GetTime(void);
+
+#define TOUCH_CAP_FRAME_MAX 64 // Longest capture frame, minimum Touch_Capture_Read max
+
+void Touch_Capture_Start(void);
+void Touch_Capture_Stop(void);
+uint16_t Touch_Capture_Read(uint8_t *buf, uint16_t max); // Whole frames only
+void Touch_Capture_Stats(uint32_t *frames, uint32_t *dropped);
+
 #endif
@@ -0,0 +1,54 @@
+/* tools/host/stm32f10x.h
+ * Host build shim : only what the portable driver code needs to compile
+ * on Linux. Peripheral registers are plain structs owned by the harness.
+ */
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define __IO volatile
+
+#define __disable_irq()
+#define __enable_irq()
+
+typedef struct {
+    __IO uint32_t CRL;
+    __IO uint32_t CRH;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t BRR;
+    __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef host_gpioa;
+extern GPIO_TypeDef host_gpioc;
+#define GPIOA (&host_gpioa)
+#define GPIOC (&host_gpioc)
+
+#define GPIO_Pin_0  ((uint16_t)0x0001)
+#define GPIO_Pin_1  ((uint16_t)0x0002)
+#define GPIO_Pin_2  ((uint16_t)0x0004)
+#define GPIO_Pin_3  ((uint16_t)0x0008)
+#define GPIO_Pin_4  ((uint16_t)0x0010)
+#define GPIO_Pin_5  ((uint16_t)0x0020)
+#define GPIO_Pin_6  ((uint16_t)0x0040)
+#define GPIO_Pin_7  ((uint16_t)0x0080)
+#define GPIO_Pin_8  ((uint16_t)0x0100)
+
+typedef enum { Bit_RESET = 0, Bit_SET } BitAction;
+
+static inline uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->IDR & GPIO_Pin) ? (uint8_t)Bit_SET : (uint8_t)Bit_RESET;
+}
+
+// Sleep until the next interrupt: the harness advances its simulated clock
+void host_wfi(void);
+#define __WFI() host_wfi()
+
+#endif /* __STM32F10x_H */
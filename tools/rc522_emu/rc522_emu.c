@@ -0,0 +1,805 @@
+/* tools/rc522_emu/rc522_emu.c
+ *
+ * MFRC522 model, as far as rc522.c uses it:
+ *   - SPI framing: address byte, then data (write) or next address (read)
+ *   - FIFO (64 bytes), FIFOLevel flush, CommIrq/DivIrq set/clear, Error,
+ *     Status2 (MFCrypto1On), Control (RxLastBits), BitFraming (StartSend,
+ *     RxAlign, TxLastBits), Coll (CollPos, ValuesAfterColl)
+ *   - Commands Idle, CalcCRC, Transceive, MFAuthent, SoftReset
+ *   - Timer with TAuto (starts at end of TX, stops on RX), TimerIRq
+ *   - IRQ pin: (CommIrq & CommIEn) | (DivIrq & DivIEn), IRqInv
+ * Cards answer REQA/WUPA, anticollision and SELECT on all cascade levels,
+ * HALT, READ and WRITE. Several cards answering at once collide bit by bit.
+ * Crypto1 is not modelled: after MFAuthent the frames stay plain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+#include "rc522.h"
+#include "spi1_dma.h"
+#include "ntag.h"
+#include "rc522_emu.h"
+
+GPIO_TypeDef host_gpioa;
+volatile uint32_t sys_tick_ms;
+
+#define CARD_IDLE       0
+#define CARD_READY      1
+#define CARD_ACTIVE     2
+#define CARD_HALT       3
+
+#define DONE_NONE       0
+#define DONE_RX         1
+#define DONE_TIMEOUT    2
+#define DONE_CRC        3
+#define DONE_AUTH       4
+#define DONE_AUTH_FAIL  5
+
+#define EMU_FRAME_MAX   72
+
+typedef struct {
+    uint8_t present;
+    uint8_t index;
+    uint16_t cs_pin;
+    uint16_t irq_pin;
+    uint8_t reg[64];
+    uint8_t fifo[64];
+    uint8_t fifo_len;
+    uint64_t field_on;          // Antenna switched on (ns)
+
+    // SPI window
+    uint8_t first;
+    uint8_t reading;
+    uint8_t addr;
+
+    // Command in progress, completes at done_at
+    uint8_t busy;
+    uint64_t done_at;
+    uint8_t rx[EMU_FRAME_MAX];
+    uint16_t rx_bits;           // Including the RxAlign offset
+    uint8_t coll_pos;           // FIFO-relative, 1-based; 0: no collision
+    uint8_t crc[2];
+
+    Emu_StatsTypeDef stats;
+} Emu_ChipTypeDef;
+
+static Emu_ChipTypeDef emu_chip[EMU_MAX_CHIPS];
+static Emu_ChipTypeDef *emu_sel = 0;
+static Emu_CardTypeDef emu_card[EMU_MAX_CARDS];
+static int emu_cards = 0;
+static uint64_t emu_now = 0;
+static uint32_t emu_rand = 1;
+
+// Pins as in rc522_readers[] (rc522.c)
+static const uint16_t emu_cs_pin[EMU_MAX_CHIPS] = { GPIO_Pin_4, GPIO_Pin_8 };
+static const uint16_t emu_irq_pin[EMU_MAX_CHIPS] = { GPIO_Pin_0, GPIO_Pin_2 };
+
+uint32_t Emu_Random(void) {
+    emu_rand ^= emu_rand << 13;
+    emu_rand ^= emu_rand >> 17;
+    emu_rand ^= emu_rand << 5;
+    return emu_rand;
+}
+
+/* --- Helpers --- */
+
+// CRC_A bit by bit, independent of the driver's table
+static void Emu_CrcA(const uint8_t *data, int len, uint8_t *out) {
+    uint16_t crc = 0x6363;
+    int i, b;
+    for (i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    out[0] = crc & 0xFF;
+    out[1] = crc >> 8;
+}
+
+static int Emu_CrcOk(const uint8_t *data, int len) {
+    uint8_t crc[2];
+    Emu_CrcA(data, len, crc);
+    return crc[0] == data[len] && crc[1] == data[len + 1];
+}
+
+static int Emu_GetBit(const uint8_t *buf, int pos) {
+    return (buf[pos / 8] >> (pos % 8)) & 1;
+}
+
+static void Emu_SetBit(uint8_t *buf, int pos, int val) {
+    if (val) {
+        buf[pos / 8] |= 1 << (pos % 8);
+    } else {
+        buf[pos / 8] &= ~(1 << (pos % 8));
+    }
+}
+
+// On air at 106 kbit/s: a parity bit per byte, start and end of frame
+static uint64_t Emu_AirTime(int bits) {
+    return (uint64_t)(bits + bits / 8 + 2) * EMU_BIT_NS;
+}
+
+static uint64_t Emu_TimerNs(Emu_ChipTypeDef *c) {
+    uint32_t presc = ((c->reg[MFRC522_REG_T_MODE] & 0x0F) << 8) | c->reg[MFRC522_REG_T_PRESCALER];
+    uint32_t reload = (c->reg[MFRC522_REG_T_RELOAD_H] << 8) | c->reg[MFRC522_REG_T_RELOAD_L];
+    return (uint64_t)(2 * presc + 1) * (reload + 1) * 1000000000ULL / 13560000ULL;
+}
+
+static void Emu_UpdateIrq(Emu_ChipTypeDef *c) {
+    int active = (c->reg[MFRC522_REG_COMM_IRQ] & c->reg[MFRC522_REG_COMM_IEN] & 0x7F) ||
+                 (c->reg[MFRC522_REG_DIV_IRQ] & c->reg[MFRC522_REG_DIV_IEN] & 0x14);
+    int low = (c->reg[MFRC522_REG_COMM_IEN] & 0x80) ? active : !active;   // IRqInv
+    if (low) {
+        host_gpioa.IDR &= ~c->irq_pin;
+    } else {
+        host_gpioa.IDR |= c->irq_pin;
+    }
+}
+
+/* --- Cards --- */
+
+static uint8_t Card_Levels(Emu_CardTypeDef *card) {
+    return card->uid_len == 4 ? 1 : card->uid_len == 7 ? 2 : 3;
+}
+
+// CLn bytes + BCC of one cascade level
+static void Card_Level(Emu_CardTypeDef *card, int lvl, uint8_t *cl) {
+    int last = (lvl == Card_Levels(card) - 1);
+    int i;
+    if (last) {
+        for (i = 0; i < 4; i++) cl[i] = card->uid[card->uid_len - 4 + i];
+    } else {
+        cl[0] = PICC_CASCADE_TAG;
+        for (i = 0; i < 3; i++) cl[1 + i] = card->uid[lvl * 3 + i];
+    }
+    cl[4] = cl[0] ^ cl[1] ^ cl[2] ^ cl[3];
+}
+
+// In the field of that chip with enough power to answer; leaving resets the card
+static int Card_Powered(Emu_CardTypeDef *card, Emu_ChipTypeDef *c) {
+    uint64_t arrive = (uint64_t)card->arrive_ms * 1000000ULL;
+    uint64_t leave = (uint64_t)card->leave_ms * 1000000ULL;
+    uint64_t on = (arrive > c->field_on) ? arrive : c->field_on;
+    int powered;
+
+    if (card->reader != c->index) {
+        return 0;               // Another chip's field, leaves this card alone
+    }
+    powered = (c->reg[MFRC522_REG_TX_CONTROL] & 0x03) && emu_now < leave && emu_now >= on + EMU_POWERUP_NS;
+    if (!powered) {
+        card->powered = 0;
+    } else if (!card->powered) {
+        card->powered = 1;
+        card->state = CARD_IDLE;
+        card->auth_sector = 0xFF;
+        card->write_blk = 0xFF;
+    }
+    return powered;
+}
+
+// Anything out of sequence sends a card back to IDLE (or HALT if it came from there)
+static void Card_Unexpected(Emu_CardTypeDef *card) {
+    if (card->state != CARD_HALT) {
+        card->state = CARD_IDLE;
+    }
+    card->auth_sector = 0xFF;
+    card->write_blk = 0xFF;
+}
+
+// Ultralight cards answer GET_VERSION as an NTAG213 (45 pages)
+#define EMU_NTAG_PAGES  45
+static const uint8_t emu_ntag213_version[8] = { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03 };
+
+static int Card_Nak(Emu_CardTypeDef *card, uint8_t *out, int *out_bits) {
+    Card_Unexpected(card);
+    out[0] = 0x04;
+    *out_bits = 4;
+    return 1;
+}
+
+// One frame from the reader; returns 1 with the answer in out (LSB first)
+static int Card_Frame(Emu_CardTypeDef *card, const uint8_t *f, int bits, uint8_t *out, int *out_bits, uint64_t *delay) {
+    uint8_t cl[5];
+    int lvl, known, i, blk;
+
+    *delay = EMU_FDT_NS + (uint64_t)card->slow_us * 1000;
+
+    if (bits == 7) {
+        uint8_t cmd = f[0] & 0x7F;
+        if ((cmd == PICC_REQIDL && card->state == CARD_IDLE) ||
+            (cmd == PICC_REQALL && (card->state == CARD_IDLE || card->state == CARD_HALT))) {
+            card->state = CARD_READY;
+            card->level = 0;
+            out[0] = 0x04 | (card->uid_len == 7 ? 0x40 : card->uid_len == 10 ? 0x80 : 0x00);
+            if (card->type == EMU_CARD_ULTRALIGHT) out[0] = 0x44;
+            out[1] = 0x00;
+            *out_bits = 16;
+            return 1;
+        }
+        Card_Unexpected(card);
+        return 0;
+    }
+
+    // Data frame of a WRITE
+    if (card->write_blk != 0xFF) {
+        blk = card->write_blk;
+        card->write_blk = 0xFF;
+        if (bits != 18 * 8 || !Emu_CrcOk(f, 16)) {
+            Card_Unexpected(card);
+            return 0;
+        }
+        memcpy(card->mem[blk], f, 16);
+        out[0] = 0x0A;
+        *out_bits = 4;
+        *delay += EMU_EEPROM_NS;
+        return 1;
+    }
+
+    switch (f[0]) {
+        case PICC_ANTICOLL:
+        case PICC_ANTICOLL_CL2:
+        case PICC_ANTICOLL_CL3:
+            lvl = (f[0] - PICC_ANTICOLL) / 2;
+            if (card->state != CARD_READY || lvl != card->level || bits < 16) {
+                if (card->state == CARD_ACTIVE) Card_Unexpected(card);
+                return 0;
+            }
+            Card_Level(card, lvl, cl);
+            if (f[1] == 0x70) {
+                // SELECT
+                if (bits != 9 * 8 || !Emu_CrcOk(f, 7)) return 0;
+                if (memcmp(&f[2], cl, 5) != 0) {
+                    card->state = CARD_IDLE;    // Another card was selected
+                    return 0;
+                }
+                if (lvl + 1 < Card_Levels(card)) {
+                    out[0] = PICC_SAK_CASCADE;
+                    card->level++;
+                } else {
+                    out[0] = (card->type == EMU_CARD_CLASSIC) ? 0x08 : (card->type == EMU_CARD_ISO_DEP) ? 0x20 : 0x00;
+                    card->state = CARD_ACTIVE;
+                }
+                Emu_CrcA(out, 1, &out[1]);
+                *out_bits = 24;
+                return 1;
+            }
+            // ANTICOLL with NVB: known bits must match, the rest of CLn+BCC follows
+            known = ((f[1] >> 4) - 2) * 8 + (f[1] & 0x0F);
+            if (known < 0 || known > 32 || bits != 16 + known) return 0;
+            for (i = 0; i < known; i++) {
+                if (Emu_GetBit(&f[2], i) != Emu_GetBit(cl, i)) return 0;
+            }
+            memset(out, 0, 5);
+            for (i = known; i < 40; i++) {
+                Emu_SetBit(out, i - known, Emu_GetBit(cl, i));
+            }
+            *out_bits = 40 - known;
+            return 1;
+
+        case PICC_HALT:
+            if (card->state == CARD_ACTIVE && bits == 32 && f[1] == 0x00 && Emu_CrcOk(f, 2)) {
+                card->state = CARD_HALT;
+                card->auth_sector = 0xFF;
+            } else {
+                Card_Unexpected(card);
+            }
+            return 0;
+
+        case PICC_READ:
+            if (card->state != CARD_ACTIVE || bits != 32 || !Emu_CrcOk(f, 2)) {
+                Card_Unexpected(card);
+                return 0;
+            }
+            blk = f[1];
+            if (card->type == EMU_CARD_CLASSIC) {
+                if (blk >= 64 || card->auth_sector != blk / 4) return Card_Nak(card, out, out_bits);
+                memcpy(out, card->mem[blk], 16);
+            } else {
+                // 4 pages of 4 bytes, wrapping at the end of memory
+                for (i = 0; i < 16; i++) {
+                    out[i] = ((uint8_t *)card->mem)[(blk * 4 + i) % sizeof(card->mem)];
+                }
+            }
+            Emu_CrcA(out, 16, &out[16]);
+            *out_bits = 18 * 8;
+            return 1;
+
+        case NTAG_CMD_FAST_READ:
+            if (card->type != EMU_CARD_ULTRALIGHT || card->state != CARD_ACTIVE || bits != 40 || !Emu_CrcOk(f, 3)) {
+                Card_Unexpected(card);
+                return 0;
+            }
+            if (f[2] < f[1] || f[2] >= EMU_NTAG_PAGES || f[2] - f[1] >= NTAG_FAST_READ_MAX) {
+                return Card_Nak(card, out, out_bits);
+            }
+            for (i = 0; i < (f[2] - f[1] + 1) * 4; i++) {
+                out[i] = ((uint8_t *)card->mem)[f[1] * 4 + i];
+            }
+            Emu_CrcA(out, i, &out[i]);
+            *out_bits = (i + 2) * 8;
+            return 1;
+
+        case NTAG_CMD_GET_VERSION:
+            if (card->type != EMU_CARD_ULTRALIGHT || card->state != CARD_ACTIVE || bits != 24 || !Emu_CrcOk(f, 1)) {
+                Card_Unexpected(card);
+                return 0;
+            }
+            memcpy(out, emu_ntag213_version, 8);
+            Emu_CrcA(out, 8, &out[8]);
+            *out_bits = 80;
+            return 1;
+
+        case NTAG_CMD_PWD_AUTH:
+            if (card->type != EMU_CARD_ULTRALIGHT || card->state != CARD_ACTIVE || bits != 56 || !Emu_CrcOk(f, 5)) {
+                Card_Unexpected(card);
+                return 0;
+            }
+            if (memcmp(&f[1], card->key, 4) != 0) {
+                return Card_Nak(card, out, out_bits);
+            }
+            out[0] = card->key[4];      // PACK
+            out[1] = card->key[5];
+            Emu_CrcA(out, 2, &out[2]);
+            *out_bits = 32;
+            return 1;
+
+        case PICC_WRITE:
+            if (card->state != CARD_ACTIVE || bits != 32 || !Emu_CrcOk(f, 2)) {
+                Card_Unexpected(card);
+                return 0;
+            }
+            blk = f[1];
+            if (card->type != EMU_CARD_CLASSIC || blk >= 64 || card->auth_sector != blk / 4 || blk % 4 == 3) {
+                return Card_Nak(card, out, out_bits);
+            }
+            card->write_blk = blk;
+            out[0] = 0x0A;
+            *out_bits = 4;
+            return 1;
+
+        default:
+            Card_Unexpected(card);
+            return 0;
+    }
+}
+
+/* --- Chip --- */
+
+static void Chip_Reset(Emu_ChipTypeDef *c) {
+    memset(c->reg, 0, sizeof(c->reg));
+    c->reg[MFRC522_REG_COMMAND] = 0x20;
+    c->reg[MFRC522_REG_COMM_IEN] = 0x80;
+    c->reg[MFRC522_REG_COMM_IRQ] = 0x14;
+    c->reg[MFRC522_REG_CONTROL] = 0x10;
+    c->reg[MFRC522_REG_COLL] = 0xA0;
+    c->reg[MFRC522_REG_MODE] = 0x3F;
+    c->reg[MFRC522_REG_TX_CONTROL] = 0x80;
+    c->reg[MFRC522_REG_VERSION] = 0x92;
+    c->fifo_len = 0;
+    c->busy = DONE_NONE;
+    Emu_UpdateIrq(c);
+}
+
+static void Chip_FieldOff(Emu_ChipTypeDef *c) {
+    int i;
+    for (i = 0; i < emu_cards; i++) {
+        if (emu_card[i].reader == c->index) {
+            emu_card[i].powered = 0;
+        }
+    }
+}
+
+// StartSend with Transceive: send the FIFO, collect what the cards in the field answer
+static void Chip_Transceive(Emu_ChipTypeDef *c) {
+    uint8_t frame[64];
+    uint8_t ans[EMU_FRAME_MAX];
+    uint8_t acc[EMU_FRAME_MAX];
+    int len = c->fifo_len;
+    int last = c->reg[MFRC522_REG_BIT_FRAMING] & 0x07;
+    int align = (c->reg[MFRC522_REG_BIT_FRAMING] >> 4) & 0x07;
+    int bits = len ? (last ? (len - 1) * 8 + last : len * 8) : 0;
+    int ans_bits, acc_bits = -1, coll = -1;
+    uint64_t delay, fdt = 0, t_end, timer;
+    int i, j, r;
+
+    memcpy(frame, c->fifo, len);
+    c->fifo_len = 0;
+    c->stats.frames++;
+    t_end = emu_now + Emu_AirTime(bits);
+
+    memset(acc, 0, sizeof(acc));
+    for (i = 0; i < emu_cards; i++) {
+        Emu_CardTypeDef *card = &emu_card[i];
+        if (!Card_Powered(card, c)) continue;
+        memset(ans, 0, sizeof(ans));
+        if (!Card_Frame(card, frame, bits, ans, &ans_bits, &delay)) continue;
+
+        if (card->drop_pct && (int)(Emu_Random() % 100) < card->drop_pct) {
+            if (Emu_Random() & 1) {
+                c->stats.dropped++;
+                continue;
+            }
+            r = Emu_Random() % ans_bits;
+            Emu_SetBit(ans, r, !Emu_GetBit(ans, r));
+            c->stats.corrupted++;
+        }
+        if (delay > fdt) fdt = delay;
+
+        if (acc_bits < 0) {
+            memcpy(acc, ans, sizeof(acc));
+            acc_bits = ans_bits;
+            continue;
+        }
+        // Second answer: the first differing bit is the collision
+        for (j = 0; j < ans_bits || j < acc_bits; j++) {
+            int a = j < acc_bits ? Emu_GetBit(acc, j) : 0;
+            int b = j < ans_bits ? Emu_GetBit(ans, j) : 0;
+            if (a != b) {
+                if (coll < 0 || j < coll) coll = j;
+                break;
+            }
+        }
+        if (ans_bits > acc_bits) acc_bits = ans_bits;
+    }
+
+    timer = (c->reg[MFRC522_REG_T_MODE] & 0x80) ? Emu_TimerNs(c) : 0;
+    if (acc_bits < 0 || (timer && fdt > timer)) {
+        if (timer) {
+            c->busy = DONE_TIMEOUT;
+            c->done_at = t_end + timer;
+        }
+        c->stats.timeouts++;
+        return;
+    }
+
+    // Bits from the collision on: 0 with ValuesAfterColl = 0
+    if (coll >= 0 && !(c->reg[MFRC522_REG_COLL] & 0x80)) {
+        for (j = coll; j < acc_bits; j++) Emu_SetBit(acc, j, 0);
+    }
+    // RxAlign: the first bit received lands on bit 'align' of the first FIFO byte
+    memset(c->rx, 0, sizeof(c->rx));
+    for (j = 0; j < acc_bits; j++) {
+        Emu_SetBit(c->rx, align + j, Emu_GetBit(acc, j));
+    }
+    c->rx_bits = align + acc_bits;
+    c->coll_pos = (coll >= 0) ? align + coll + 1 : 0;
+    c->busy = DONE_RX;
+    c->done_at = t_end + fdt + Emu_AirTime(acc_bits);
+}
+
+// MFAuthent: FIFO holds mode, block, key[6], UID[4]
+static void Chip_Auth(Emu_ChipTypeDef *c) {
+    uint8_t *f = c->fifo;
+    uint64_t timer = Emu_TimerNs(c);
+    int i;
+
+    c->busy = DONE_AUTH_FAIL;
+    c->done_at = emu_now + Emu_AirTime(16) + timer;
+    if (c->fifo_len >= 12) {
+        for (i = 0; i < emu_cards; i++) {
+            Emu_CardTypeDef *card = &emu_card[i];
+            if (!Card_Powered(card, c) || card->state != CARD_ACTIVE) continue;
+            if (card->type == EMU_CARD_CLASSIC && f[1] < 64 &&
+                memcmp(&f[2], card->key, 6) == 0 &&
+                memcmp(&f[8], &card->uid[card->uid_len - 4], 4) == 0) {
+                card->auth_sector = f[1] / 4;
+                c->busy = DONE_AUTH;
+                c->done_at = emu_now + EMU_AUTH_NS + (uint64_t)card->slow_us * 4000;
+            } else {
+                Card_Unexpected(card);
+            }
+            break;
+        }
+    }
+    c->fifo_len = 0;
+    c->stats.frames++;
+}
+
+static void Chip_Command(Emu_ChipTypeDef *c, uint8_t val) {
+    uint8_t cmd = val & 0x0F;
+
+    c->reg[MFRC522_REG_COMMAND] = val & 0x3F;
+    switch (cmd) {
+        case PCD_IDLE:
+            c->busy = DONE_NONE;
+            break;
+        case PCD_CALCCRC:
+            Emu_CrcA(c->fifo, c->fifo_len, c->crc);
+            c->busy = DONE_CRC;
+            c->done_at = emu_now + 1000 + (uint64_t)c->fifo_len * EMU_CRC_NS;
+            c->fifo_len = 0;
+            break;
+        case PCD_AUTHENT:
+            Chip_Auth(c);
+            break;
+        case PCD_RESETPHASE:
+            Chip_Reset(c);
+            break;
+        default:
+            c->busy = DONE_NONE;    // Transceive waits for StartSend
+            break;
+    }
+}
+
+static void Chip_Complete(Emu_ChipTypeDef *c) {
+    int n, i;
+
+    switch (c->busy) {
+        case DONE_RX:
+            n = (c->rx_bits + 7) / 8;
+            for (i = 0; i < n; i++) {
+                if (c->fifo_len < 64) {
+                    c->fifo[c->fifo_len++] = c->rx[i];
+                } else {
+                    c->reg[MFRC522_REG_ERROR] |= 0x10;   // BufferOvfl
+                }
+            }
+            c->reg[MFRC522_REG_CONTROL] = (c->reg[MFRC522_REG_CONTROL] & ~0x07) | (c->rx_bits % 8);
+            c->reg[MFRC522_REG_ERROR] = c->coll_pos ? 0x08 : 0x00;
+            c->reg[MFRC522_REG_COLL] &= 0x80;
+            if (!c->coll_pos || c->coll_pos > 32) {
+                c->reg[MFRC522_REG_COLL] |= 0x20;       // CollPosNotValid
+            } else {
+                c->reg[MFRC522_REG_COLL] |= c->coll_pos & 0x1F;   // 32 reads as 0
+            }
+            c->reg[MFRC522_REG_COMM_IRQ] |= 0x60 | (c->coll_pos ? 0x02 : 0x00);
+            c->stats.answers++;
+            if (c->coll_pos) c->stats.collisions++;
+            break;
+        case DONE_TIMEOUT:
+            c->reg[MFRC522_REG_ERROR] = 0x00;
+            c->reg[MFRC522_REG_COMM_IRQ] |= 0x41;
+            break;
+        case DONE_CRC:
+            c->reg[MFRC522_REG_CRC_RESULT_L] = c->crc[0];
+            c->reg[MFRC522_REG_CRC_RESULT_M] = c->crc[1];
+            c->reg[MFRC522_REG_DIV_IRQ] |= 0x04;
+            break;
+        case DONE_AUTH:
+            c->reg[MFRC522_REG_STATUS2] |= 0x08;
+            c->reg[MFRC522_REG_COMM_IRQ] |= 0x10;
+            c->reg[MFRC522_REG_COMMAND] &= ~0x0F;
+            break;
+        case DONE_AUTH_FAIL:
+            c->reg[MFRC522_REG_COMM_IRQ] |= 0x01;
+            c->stats.timeouts++;
+            break;
+    }
+    c->busy = DONE_NONE;
+    Emu_UpdateIrq(c);
+}
+
+static uint8_t Chip_Read(Emu_ChipTypeDef *c, uint8_t addr) {
+    uint8_t val;
+    switch (addr) {
+        case MFRC522_REG_FIFO_DATA:
+            if (!c->fifo_len) return 0x00;
+            val = c->fifo[0];
+            memmove(c->fifo, c->fifo + 1, --c->fifo_len);
+            return val;
+        case MFRC522_REG_FIFO_LEVEL:
+            return c->fifo_len;
+        default:
+            return c->reg[addr];
+    }
+}
+
+static void Chip_Write(Emu_ChipTypeDef *c, uint8_t addr, uint8_t val) {
+    uint8_t was;
+
+    switch (addr) {
+        case MFRC522_REG_COMMAND:
+            Chip_Command(c, val);
+            break;
+        case MFRC522_REG_COMM_IRQ:
+        case MFRC522_REG_DIV_IRQ:
+            if (val & 0x80) {
+                c->reg[addr] |= val & 0x7F;
+            } else {
+                c->reg[addr] &= ~(val & 0x7F);
+            }
+            break;
+        case MFRC522_REG_FIFO_DATA:
+            if (c->fifo_len < 64) {
+                c->fifo[c->fifo_len++] = val;
+            } else {
+                c->reg[MFRC522_REG_ERROR] |= 0x10;
+            }
+            break;
+        case MFRC522_REG_FIFO_LEVEL:
+            if (val & 0x80) {
+                c->fifo_len = 0;
+                c->reg[MFRC522_REG_ERROR] &= ~0x10;
+            }
+            break;
+        case MFRC522_REG_BIT_FRAMING:
+            c->reg[addr] = val;
+            if ((val & 0x80) && (c->reg[MFRC522_REG_COMMAND] & 0x0F) == PCD_TRANSCEIVE && c->busy == DONE_NONE) {
+                Chip_Transceive(c);
+            }
+            break;
+        case MFRC522_REG_STATUS2:
+            // MFCrypto1On can only be cleared by software
+            c->reg[addr] = (val & 0xC0) | (c->reg[addr] & 0x07) | (c->reg[addr] & val & 0x08);
+            break;
+        case MFRC522_REG_TX_CONTROL:
+            was = c->reg[addr] & 0x03;
+            c->reg[addr] = val;
+            if (!was && (val & 0x03)) c->field_on = emu_now;
+            if (was && !(val & 0x03)) Chip_FieldOff(c);
+            break;
+        case MFRC522_REG_COLL:
+            c->reg[addr] = (c->reg[addr] & 0x7F) | (val & 0x80);
+            break;
+        case MFRC522_REG_ERROR:
+        case MFRC522_REG_STATUS1:
+        case MFRC522_REG_CONTROL:
+        case MFRC522_REG_VERSION:
+            break;      // Read-only here
+        default:
+            c->reg[addr] = val;
+            break;
+    }
+    Emu_UpdateIrq(c);
+}
+
+/* --- SPI1 host backend --- */
+
+static uint8_t Emu_SpiByte(Emu_ChipTypeDef *c, uint8_t b) {
+    uint8_t out;
+
+    if (!c || !c->present) {
+        return 0xFF;            // MISO pulled up, nobody drives it
+    }
+    if (c->first) {
+        c->first = 0;
+        c->reading = b & 0x80;
+        c->addr = (b >> 1) & 0x3F;
+        return 0x00;
+    }
+    if (c->reading) {
+        out = Chip_Read(c, c->addr);
+        c->addr = (b >> 1) & 0x3F;
+        return out;
+    }
+    Chip_Write(c, c->addr, b);
+    return 0x00;
+}
+
+static void Emu_Select(GPIO_TypeDef *port, uint16_t pin, uint8_t active) {
+    int i;
+    (void)port;
+    if (!active) {
+        emu_sel = 0;
+        return;
+    }
+    for (i = 0; i < EMU_MAX_CHIPS; i++) {
+        // Selecting again with CS still low (SPI1_KEEP_CS) is no new frame
+        if (emu_chip[i].cs_pin == pin && emu_sel != &emu_chip[i]) {
+            emu_sel = &emu_chip[i];
+            emu_sel->first = 1;
+        }
+    }
+}
+
+static void Emu_Start(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    uint16_t i;
+    uint8_t b;
+
+    for (i = 0; i < len; i++) {
+        b = Emu_SpiByte(emu_sel, tx ? tx[i] : 0x00);
+        if (rx) rx[i] = b;
+    }
+    if (emu_sel) {
+        emu_sel->stats.spi_xfers++;
+        emu_sel->stats.spi_bytes += len;
+    }
+    Emu_Advance(EMU_SPI_XFER_NS + (uint64_t)len * EMU_SPI_BYTE_NS);
+    SPI1_Complete();
+}
+
+static const SPI1_BackendTypeDef emu_backend = { Emu_Select, Emu_Start };
+
+/* --- Clock --- */
+
+static Emu_ChipTypeDef *Emu_NextChip(void) {
+    Emu_ChipTypeDef *next = 0;
+    int i;
+    for (i = 0; i < EMU_MAX_CHIPS; i++) {
+        if (emu_chip[i].busy != DONE_NONE && (!next || emu_chip[i].done_at < next->done_at)) {
+            next = &emu_chip[i];
+        }
+    }
+    return next;
+}
+
+void Emu_Advance(uint64_t ns) {
+    uint64_t target = emu_now + ns;
+    Emu_ChipTypeDef *c;
+
+    while ((c = Emu_NextChip()) != 0 && c->done_at <= target) {
+        if (c->done_at > emu_now) emu_now = c->done_at;
+        Chip_Complete(c);
+    }
+    emu_now = target;
+    sys_tick_ms = (uint32_t)(emu_now / 1000000ULL);
+}
+
+// WFI: the next chip event or SysTick, whichever comes first
+void host_wfi(void) {
+    uint64_t next = (emu_now / 1000000ULL + 1) * 1000000ULL;
+    Emu_ChipTypeDef *c = Emu_NextChip();
+    if (c && c->done_at < next) next = c->done_at;
+    Emu_Advance(next > emu_now ? next - emu_now : 0);
+}
+
+void Delay(__IO uint32_t nTime) {
+    Emu_Advance((uint64_t)nTime * 1000000ULL);
+}
+
+uint64_t Emu_Now(void) {
+    return emu_now;
+}
+
+/* --- Setup --- */
+
+void Emu_Init(uint8_t chips, uint32_t seed) {
+    int i;
+
+    memset(emu_chip, 0, sizeof(emu_chip));
+    emu_cards = 0;
+    emu_now = 0;
+    sys_tick_ms = 0;
+    emu_rand = seed ? seed : 1;
+    host_gpioa.IDR = 0xFFFF;    // Pull-ups
+    for (i = 0; i < EMU_MAX_CHIPS; i++) {
+        emu_chip[i].index = i;
+        emu_chip[i].present = (i < chips);
+        emu_chip[i].cs_pin = emu_cs_pin[i];
+        emu_chip[i].irq_pin = emu_irq_pin[i];
+        Chip_Reset(&emu_chip[i]);
+    }
+    SPI1_SetBackend(&emu_backend);
+}
+
+void Emu_Plug(uint8_t chip) {
+    if (chip >= EMU_MAX_CHIPS || emu_chip[chip].present) return;
+    emu_chip[chip].present = 1;
+    Chip_Reset(&emu_chip[chip]);
+}
+
+Emu_CardTypeDef *Emu_AddCard(uint8_t type, const uint8_t *uid, uint8_t uid_len) {
+    Emu_CardTypeDef *card;
+
+    if (emu_cards >= EMU_MAX_CARDS) return 0;
+    card = &emu_card[emu_cards++];
+    memset(card, 0, sizeof(*card));
+    card->type = type;
+    memcpy(card->uid, uid, uid_len);
+    card->uid_len = uid_len;
+    memset(card->key, 0xFF, 6);
+    card->auth_sector = 0xFF;
+    card->write_blk = 0xFF;
+    card->leave_ms = 0xFFFFFFFF;
+    if (type == EMU_CARD_CLASSIC) {
+        memcpy(card->mem[0], uid, 4);      // Manufacturer block starts with the UID
+        card->mem[0][4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+    } else {
+        memcpy(card->mem[0], uid, uid_len);
+    }
+    return card;
+}
+
+Emu_CardTypeDef *Emu_Card(int i) {
+    return (i >= 0 && i < emu_cards) ? &emu_card[i] : 0;
+}
+
+int Emu_CardCount(void) {
+    return emu_cards;
+}
+
+void Emu_GetStats(uint8_t chip, Emu_StatsTypeDef *st) {
+    *st = emu_chip[chip].stats;
+}
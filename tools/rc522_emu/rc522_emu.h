@@ -0,0 +1,74 @@
+/* tools/rc522_emu/rc522_emu.h
+ *
+ * Register-level MFRC522 emulator for the host build of rc522.c.
+ * The chips sit behind the SPI1 host backend (spi1_dma.c, SPI1_HOST) and
+ * drive their IRQ pins on host_gpioa; virtual ISO14443A cards enter and
+ * leave their fields on a simulated clock.
+ */
+#ifndef __RC522_EMU_H
+#define __RC522_EMU_H
+
+#include <stdint.h>
+
+#define EMU_MAX_CHIPS   2       // Same pins as rc522_readers[] in rc522.c
+#define EMU_MAX_CARDS   512
+
+// Timing (ns unless noted)
+#define EMU_SPI_BYTE_NS     889     // SPI1 at 72 MHz / 8
+#define EMU_SPI_XFER_NS     1500    // Per transfer: descriptor, CS, DMA or polling setup
+#define EMU_BIT_NS          9440    // 106 kbit/s, 128 / 13.56 MHz
+#define EMU_FDT_NS          86400   // Frame delay time, 1172 / 13.56 MHz
+#define EMU_CRC_NS          500     // Coprocessor, per byte
+#define EMU_AUTH_NS         1200000 // Three-pass authentication
+#define EMU_EEPROM_NS       2600000 // Classic WRITE: data frame to ACK
+#define EMU_POWERUP_NS      2500000 // Card needs this much field before it answers
+
+// Card types
+#define EMU_CARD_CLASSIC    0       // MIFARE Classic 1K (SAK 0x08, ATQA 0x0004)
+#define EMU_CARD_ULTRALIGHT 1       // NTAG213 (SAK 0x00, ATQA 0x0044): READ, FAST_READ, GET_VERSION, PWD_AUTH
+#define EMU_CARD_ISO_DEP    2       // Bank card or phone (SAK 0x20, ATQA 0x0004), UID only
+
+typedef struct {
+    // Set by the scenario
+    uint8_t type;
+    uint8_t uid[10];
+    uint8_t uid_len;                // 4, 7 or 10
+    uint8_t reader;                 // Whose field the card enters
+    uint32_t arrive_ms;
+    uint32_t leave_ms;
+    uint32_t slow_us;               // Extra frame delay on every answer
+    uint8_t drop_pct;               // Chance an answer is lost (half) or corrupted (half)
+    uint8_t key[6];                 // Classic: Key A of every sector; NTAG: PWD[4] + PACK[2]
+    uint8_t mem[64][16];            // Classic: blocks; Ultralight: pages 4 per row
+
+    // ISO14443-3A state
+    uint8_t state;
+    uint8_t level;                  // Cascade level while READY
+    uint8_t powered;
+    uint8_t auth_sector;            // 0xFF: none
+    uint8_t write_blk;              // 0xFF: no WRITE waiting for its data frame
+} Emu_CardTypeDef;
+
+typedef struct {
+    uint32_t frames;                // Frames sent by the reader
+    uint32_t answers;               // Frames some card answered
+    uint32_t collisions;
+    uint32_t timeouts;
+    uint32_t dropped;
+    uint32_t corrupted;
+    uint32_t spi_xfers;
+    uint32_t spi_bytes;
+} Emu_StatsTypeDef;
+
+void Emu_Init(uint8_t chips, uint32_t seed);
+void Emu_Plug(uint8_t chip);         // Power up a chip that was absent at Emu_Init
+Emu_CardTypeDef *Emu_AddCard(uint8_t type, const uint8_t *uid, uint8_t uid_len);
+Emu_CardTypeDef *Emu_Card(int i);
+int Emu_CardCount(void);
+
+uint64_t Emu_Now(void);             // Simulated time, ns
+void Emu_Advance(uint64_t ns);      // CPU work between SPI transfers
+void Emu_GetStats(uint8_t chip, Emu_StatsTypeDef *st);
+uint32_t Emu_Random(void);
+
+#endif /* __RC522_EMU_H */
@@ -0,0 +1,405 @@
+/* tools/rc522_emu/rc522_sim.c
+ *
+ * Runs the unmodified reader stack (rc522.c, spi1_dma.c, rfid_poll.c,
+ * uid_cache.c) against the MFRC522 emulator, with the same loop as main.c,
+ * and reports what each scan costs in SPI transactions and simulated time.
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -DSPI1_HOST -Itools/host -Iuser/inc -Itools/rc522_emu \
+ *       tools/rc522_emu/rc522_sim.c tools/rc522_emu/rc522_emu.c \
+ *       user/rc522.c user/ntag.c user/spi1_dma.c user/rfid_poll.c user/uid_cache.c \
+ *       -o rc522_sim
+ *
+ * Usage:
+ *   ./rc522_sim [scenario.txt] [-v]
+ *
+ * Scenario file, one directive per line (# starts a comment):
+ *   readers <n>                 RC522 chips fitted (1..2)
+ *   plug <at_ms> <reader>       power up a reader that was not fitted at start
+ *   duration <ms>               simulated time (default: last card + 5 s)
+ *   seed <n>
+ *   mode fast|slow              poll scheduler mode (rfid_poll.h)
+ *   ui <block_ms> <hold_ms>     per accepted tap: blocking beep, result screen
+ *                               (the screen no longer pauses scanning)
+ *   record on|off               read the student record like main.c's fallback
+ *   card <at_ms> <dwell_ms> <reader> <uid hex> [ultralight|isodep] [slow=<us>] [drop=<pct>]
+ *   crowd <count> <span_ms> [dwell=<ms>] [uid7=<pct>] [slow=<pct>] [drop=<pct>]
+ * Without a file: 100 students over 120 s at two doors.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rc522.h"
+#include "ntag.h"
+#include "rfid_poll.h"
+#include "uid_cache.h"
+#include "rc522_emu.h"
+
+// Millisecond tick, advanced by the emulator
+extern volatile uint32_t sys_tick_ms;
+
+#define SIM_LOOP_NS     20000       // One pass of the main loop without RFID work
+
+typedef struct {
+    uint32_t first_ms;              // First accepted scan, 0: never
+    uint32_t scans;
+} Sim_CardTypeDef;
+
+static Sim_CardTypeDef sim_card[EMU_MAX_CARDS];
+
+// Scenario settings
+static int cfg_readers = 2;
+static uint32_t cfg_duration = 0;
+static uint32_t cfg_seed = 1;
+static uint8_t cfg_mode = POLL_FAST;
+static uint32_t cfg_block_ms = 300;     // Beep(1): 150 ms on, 150 ms off
+static uint32_t cfg_hold_ms = 1000;     // Result screen, informational only
+static int cfg_record = 0;
+static int verbose = 0;
+static uint32_t cfg_plug_ms[EMU_MAX_CHIPS];     // 0: none
+
+// Results
+static uint64_t cycle_start[RC522_NUM_READERS];     // ns, minus UI time (see sim_blocked)
+static uint64_t sim_blocked;                        // ns spent in the UI after accepted scans
+static uint32_t cycle_spi[RC522_NUM_READERS];
+static long st_scans, st_accepted, st_repeats, st_phantom, st_rejects;
+static long st_rec_ok, st_rec_fail;
+static double st_scan_us, st_scan_us_max, st_scan_spi, st_scan_spi_max;
+
+static int Hex_Parse(const char *s, uint8_t *out, int max) {
+    int n = 0;
+    unsigned v;
+    while (s[0] && s[1] && n < max && sscanf(s, "%2x", &v) == 1) {
+        out[n++] = v;
+        s += 2;
+    }
+    return n;
+}
+
+static uint32_t Opt(const char *line, const char *key, uint32_t def) {
+    const char *p = strstr(line, key);
+    return p ? (uint32_t)strtoul(p + strlen(key), 0, 10) : def;
+}
+
+// Student record, layout as in rc522.c: sector RC522_RECORD_SECTOR or NTAG_RECORD_PAGE
+static void Sim_Record(Emu_CardTypeDef *card, uint32_t id) {
+    uint8_t *b = (card->type == EMU_CARD_ULTRALIGHT) ? (uint8_t *)card->mem + NTAG_RECORD_PAGE * NTAG_PAGE_SIZE
+                                                     : card->mem[RC522_RECORD_SECTOR * 4];
+    uint8_t chk = 0;
+    int i;
+
+    memset(b, 0, 32);
+    b[0] = 'S';
+    b[1] = 'R';
+    b[2] = 0x01;
+    for (i = 0; i < 4; i++) {
+        b[3 + i] = id >> (8 * i);
+        b[7 + i] = (i == 0) ? 0x01 : 0x00;     // Course bit 0
+    }
+    sprintf((char *)&b[16], "S%06u", (unsigned)(id % 1000000));
+    for (i = 0; i < 32; i++) {
+        if (i != 15) chk ^= b[i];
+    }
+    b[15] = chk;
+}
+
+static void Sim_Crowd(const char *line) {
+    int count, i, j;
+    uint32_t span;
+    uint32_t dwell = Opt(line, "dwell=", 2000);
+    uint32_t uid7 = Opt(line, "uid7=", 30);
+    uint32_t slow = Opt(line, "slow=", 0);
+    uint32_t drop = Opt(line, "drop=", 0);
+    uint8_t uid[10];
+    Emu_CardTypeDef *card;
+
+    if (sscanf(line, "crowd %d %u", &count, &span) != 2) return;
+    for (i = 0; i < count; i++) {
+        int len = (Emu_Random() % 100 < uid7) ? 7 : 4;
+        for (j = 0; j < len; j++) uid[j] = Emu_Random();
+        if (len == 7) {
+            uid[0] = 0x04;                  // NXP
+        } else if (uid[0] == PICC_CASCADE_TAG || uid[0] == 0x08) {
+            uid[0] ^= 0x40;                 // Not a cascade tag, not a random ID
+        }
+        card = Emu_AddCard(EMU_CARD_CLASSIC, uid, len);
+        if (!card) return;
+        card->reader = Emu_Random() % cfg_readers;
+        card->arrive_ms = 1000 + Emu_Random() % span;
+        card->leave_ms = card->arrive_ms + dwell / 2 + Emu_Random() % (dwell + 1);
+        card->drop_pct = drop;
+        if (Emu_Random() % 100 < slow) {
+            card->slow_us = 200 + Emu_Random() % 700;
+        }
+        Sim_Record(card, 20250000 + Emu_CardCount());
+    }
+}
+
+static void Sim_Card(const char *line) {
+    unsigned at, dwell, reader;
+    char hex[32];
+    uint8_t uid[10];
+    int len;
+    Emu_CardTypeDef *card;
+
+    if (sscanf(line, "card %u %u %u %31s", &at, &dwell, &reader, hex) != 4) return;
+    len = Hex_Parse(hex, uid, 10);
+    if (len != 4 && len != 7 && len != 10) {
+        fprintf(stderr, "bad uid: %s\n", hex);
+        return;
+    }
+    card = Emu_AddCard(strstr(line, "ultralight") ? EMU_CARD_ULTRALIGHT :
+                       strstr(line, "isodep") ? EMU_CARD_ISO_DEP : EMU_CARD_CLASSIC, uid, len);
+    if (!card) return;
+    card->reader = reader;
+    card->arrive_ms = at;
+    card->leave_ms = at + dwell;
+    card->slow_us = Opt(line, "slow=", 0);
+    card->drop_pct = Opt(line, "drop=", 0);
+    Sim_Record(card, 20250000 + Emu_CardCount());
+}
+
+static int Sim_Load(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[160];
+    char word[16];
+
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    // Settings first, cards need the reader count and the seed
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "readers %d", &cfg_readers) == 1) continue;
+        if (sscanf(line, "seed %u", &cfg_seed) == 1) continue;
+    }
+    if (cfg_readers < 1) cfg_readers = 1;
+    if (cfg_readers > EMU_MAX_CHIPS) cfg_readers = EMU_MAX_CHIPS;
+    Emu_Init(cfg_readers, cfg_seed);
+
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%15s", word) != 1) continue;
+        if (strcmp(word, "duration") == 0) {
+            sscanf(line, "duration %u", &cfg_duration);
+        } else if (strcmp(word, "mode") == 0) {
+            cfg_mode = strstr(line, "slow") ? POLL_SLOW : POLL_FAST;
+        } else if (strcmp(word, "ui") == 0) {
+            sscanf(line, "ui %u %u", &cfg_block_ms, &cfg_hold_ms);
+        } else if (strcmp(word, "record") == 0) {
+            cfg_record = strstr(line, "on") != 0;
+        } else if (strcmp(word, "card") == 0) {
+            Sim_Card(line);
+        } else if (strcmp(word, "crowd") == 0) {
+            Sim_Crowd(line);
+        } else if (strcmp(word, "plug") == 0) {
+            uint32_t at;
+            int reader;
+            if (sscanf(line, "plug %u %d", &at, &reader) == 2 && reader >= cfg_readers && reader < EMU_MAX_CHIPS) {
+                cfg_plug_ms[reader] = at ? at : 1;
+            }
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+static Emu_CardTypeDef *Sim_Find(const RC522_UidTypeDef *uid, int *idx) {
+    Emu_CardTypeDef *card;
+    int i;
+    for (i = 0; (card = Emu_Card(i)) != 0; i++) {
+        if (card->uid_len == uid->size && memcmp(card->uid, uid->uid, uid->size) == 0) {
+            *idx = i;
+            return card;
+        }
+    }
+    return 0;
+}
+
+// What main.c does with a UID event
+static void Sim_Scan(const RC522_ScanTypeDef *scan) {
+    RC522_StatsTypeDef rs;
+    RC522_RecordTypeDef rec;
+    uint8_t key[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    Emu_CardTypeDef *card;
+    double us, spi;
+    int idx, i, r;
+
+    RC522_GetStats(scan->reader, &rs);
+    us = (Emu_Now() - sim_blocked - cycle_start[scan->reader]) / 1000.0;
+    spi = rs.transactions - cycle_spi[scan->reader];
+    st_scans++;
+    st_scan_us += us;
+    st_scan_spi += spi;
+    if (us > st_scan_us_max) st_scan_us_max = us;
+    if (spi > st_scan_spi_max) st_scan_spi_max = spi;
+
+    card = Sim_Find(&scan->uid, &idx);
+    if (verbose) {
+        printf("%9.3f s  R%u  #%-4lu ", Emu_Now() / 1e9, scan->reader, (unsigned long)scan->seq);
+        for (i = 0; i < scan->uid.size; i++) printf("%02X", scan->uid.uid[i]);
+        printf("%*s spi=%-3.0f %7.0f us%s\n", 2 * (10 - scan->uid.size), "", spi, us, card ? "" : "  PHANTOM");
+    }
+    if (!card) {
+        st_phantom++;
+        return;
+    }
+    sim_card[idx].scans++;
+
+    if (UidCache_Recent(&scan->uid, sys_tick_ms)) {
+        st_repeats++;
+        return;
+    }
+    if (cfg_record && (RC522_IS_CLASSIC(scan->uid.type) || scan->uid.type == RC522_TYPE_ULTRALIGHT)) {
+        if (scan->uid.type == RC522_TYPE_ULTRALIGHT) {
+            r = NTAG_ReadRecord(0, &rec);
+        } else {
+            r = RC522_ReadRecord((RC522_UidTypeDef *)&scan->uid, key, &rec);
+        }
+        if (r == MI_OK) {
+            st_rec_ok++;
+        } else {
+            st_rec_fail++;
+        }
+    }
+    UidCache_Add(&scan->uid, sys_tick_ms);
+    st_accepted++;
+    if (!sim_card[idx].first_ms) {
+        sim_card[idx].first_ms = sys_tick_ms;
+    }
+    Emu_Advance((uint64_t)cfg_block_ms * 1000000ULL);   // Beep() blocks
+    sim_blocked += (uint64_t)cfg_block_ms * 1000000ULL;
+}
+
+// Idle_Wait from main.c
+static void Sim_IdleWait(uint32_t ms) {
+    uint32_t start = sys_tick_ms;
+    while ((sys_tick_ms - start) < ms) {
+        if (RC522_ScanReady()) break;
+        __WFI();
+    }
+}
+
+static int Cmp_U32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    RC522_ScanTypeDef scan;
+    RC522_StatsTypeDef rs;
+    Emu_StatsTypeDef es;
+    Emu_CardTypeDef *card;
+    uint8_t evt;
+    uint32_t ttd[EMU_MAX_CARDS];
+    int n_ttd = 0, missed = 0;
+    uint32_t last = 0;
+    uint64_t end_ns;
+    struct timespec t0, t1;
+    double cpu_ns;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (!Sim_Load(argv[i])) {
+            return 1;
+        }
+    }
+    if (Emu_CardCount() == 0) {
+        Emu_Init(cfg_readers, cfg_seed);
+        Sim_Crowd("crowd 100 120000");
+    }
+    for (i = 0; (card = Emu_Card(i)) != 0; i++) {
+        if (card->leave_ms != 0xFFFFFFFF && card->leave_ms > last) last = card->leave_ms;
+    }
+    if (!cfg_duration) cfg_duration = last + 5000;
+    end_ns = (uint64_t)cfg_duration * 1000000ULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    RC522_InitReaders();
+    UidCache_Clear();
+    Poll_Init();
+    Poll_SetMode(cfg_mode);
+
+    while (Emu_Now() < end_ns) {
+        for (i = 0; i < EMU_MAX_CHIPS; i++) {
+            if (cfg_plug_ms[i] && sys_tick_ms >= cfg_plug_ms[i]) {
+                Emu_Plug(i);
+                cfg_plug_ms[i] = 0;
+                if (i >= cfg_readers) cfg_readers = i + 1;
+                if (verbose) printf("%9.3f s  R%d  plugged in\n", Emu_Now() / 1e9, i);
+            }
+        }
+        RC522_Health();
+
+        if (Poll_Due()) {
+            RC522_StartCycle();
+            for (i = 0; i < RC522_NUM_READERS; i++) {
+                RC522_GetStats(i, &rs);
+                cycle_start[i] = Emu_Now() - sim_blocked;
+                cycle_spi[i] = rs.transactions;
+            }
+        }
+        evt = RC522_Scan(&scan);
+        Poll_Event(evt);
+        if (evt == RC522_EVT_UID) {
+            Sim_Scan(&scan);
+        } else if (evt == RC522_EVT_REJECT) {
+            st_rejects++;
+            if (verbose) {
+                printf("%9.3f s  R%u  rejected %s\n", Emu_Now() / 1e9, scan.reader, RC522_TypeName(scan.uid.type));
+            }
+        }
+        Emu_Advance(SIM_LOOP_NS);
+        Sim_IdleWait(Poll_NextDelay(50));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    cpu_ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+    for (i = 0; (card = Emu_Card(i)) != 0; i++) {
+        if (sim_card[i].first_ms) {
+            ttd[n_ttd++] = sim_card[i].first_ms - (card->arrive_ms > 0 ? card->arrive_ms : 0);
+        } else {
+            missed++;
+            if (verbose) {
+                int j;
+                printf("missed: R%u ", card->reader);
+                for (j = 0; j < card->uid_len; j++) printf("%02X", card->uid[j]);
+                printf(" %u..%u ms\n", (unsigned)card->arrive_ms, (unsigned)card->leave_ms);
+            }
+        }
+    }
+    qsort(ttd, n_ttd, sizeof(ttd[0]), Cmp_U32);
+
+    printf("simulated        : %.1f s, %d reader(s), %s mode\n", cfg_duration / 1000.0, cfg_readers,
+           cfg_mode == POLL_FAST ? "fast" : "slow");
+    printf("cards            : %d (%d detected, %d missed)\n", Emu_CardCount(), n_ttd, missed);
+    printf("scans            : %ld (%ld accepted, %ld repeats, %ld phantom), %ld rejected\n",
+           st_scans, st_accepted, st_repeats, st_phantom, st_rejects);
+    printf("per scan         : %.1f SPI transactions (max %.0f), %.0f us (max %.0f)\n",
+           st_scans ? st_scan_spi / st_scans : 0.0, st_scan_spi_max,
+           st_scans ? st_scan_us / st_scans : 0.0, st_scan_us_max);
+    if (n_ttd) {
+        printf("time to accept   : median %u ms, p95 %u ms, max %u ms (from arrival)\n",
+               (unsigned)ttd[n_ttd / 2], (unsigned)ttd[n_ttd * 95 / 100], (unsigned)ttd[n_ttd - 1]);
+    }
+    if (cfg_record) {
+        printf("record reads     : %ld ok, %ld failed\n", st_rec_ok, st_rec_fail);
+    }
+    for (i = 0; i < cfg_readers; i++) {
+        Emu_GetStats(i, &es);
+        RC522_GetStats(i, &rs);
+        printf("reader %d chip    : %lu frames, %lu answered, %lu collisions, %lu timeouts, %lu dropped, %lu corrupted\n", i,
+               (unsigned long)es.frames, (unsigned long)es.answers, (unsigned long)es.collisions,
+               (unsigned long)es.timeouts, (unsigned long)es.dropped, (unsigned long)es.corrupted);
+        printf("reader %d driver  : %lu SPI, %lu cmd, %lu tmo, %lu coll, %lu crc, %lu frame, %lu lost irq, %lu reinit\n", i,
+               (unsigned long)rs.transactions, (unsigned long)rs.commands, (unsigned long)rs.timeouts,
+               (unsigned long)rs.collisions, (unsigned long)rs.crc_errors, (unsigned long)rs.frame_errors,
+               (unsigned long)rs.lost_irqs, (unsigned long)rs.reinits);
+    }
+    printf("host cpu         : %.2f s (%.0f ns per simulated ms)\n", cpu_ns / 1e9, cpu_ns / cfg_duration);
+    return (st_phantom || missed) ? 2 : 0;
+}
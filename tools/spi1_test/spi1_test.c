@@ -0,0 +1,251 @@
+/* tools/spi1_test/spi1_test.c
+ *
+ * Checks the SPI1 transfer queue (spi1_dma.c) against a fake backend:
+ * submission order, chip select handling, completion callbacks and the
+ * re-entrant path where a transfer finishes inside backend->start.
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -DSPI1_HOST -Itools/host -Iuser/inc \
+ *       tools/spi1_test/spi1_test.c user/spi1_dma.c -o spi1_test
+ *
+ * Usage:
+ *   ./spi1_test          exit status 0 when every check passes
+ *
+ * The fake backend mirrors the hardware one: transfers shorter than
+ * SPI1_DMA_MIN complete inline (polled), longer ones stay active until the
+ * test calls SPI1_Complete, as the DMA interrupt would.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "spi1_dma.h"
+
+GPIO_TypeDef host_gpioa;
+GPIO_TypeDef host_gpioc;
+
+void host_wfi(void) {
+}
+
+#define LOG_MAX 64
+
+// What the backend saw, in order: S/D (select, deselect) + port + pin mask,
+// T + length + first tx byte
+static char fake_log[LOG_MAX][16];
+static int fake_n;
+static int fake_depth, fake_depth_max;  // Nesting of backend->start
+static uint8_t fake_pending;            // A DMA-sized transfer is running
+static uint8_t fake_byte;               // Next byte the "slave" answers
+
+static void Fake_Log(const char *s) {
+    if (fake_n < LOG_MAX) snprintf(fake_log[fake_n++], sizeof(fake_log[0]), "%s", s);
+}
+
+static void Fake_Select(GPIO_TypeDef *port, uint16_t pin, uint8_t active) {
+    char s[16];
+    snprintf(s, sizeof(s), "%c%c%u", active ? 'S' : 'D', port == GPIOA ? 'A' : 'C', pin);
+    Fake_Log(s);
+}
+
+static void Fake_Start(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    char s[16];
+    uint16_t i;
+
+    snprintf(s, sizeof(s), "T%u:%02X", len, tx ? tx[0] : 0);
+    Fake_Log(s);
+    for (i = 0; i < len; i++) {
+        if (rx) rx[i] = fake_byte++;
+    }
+    if (len < SPI1_DMA_MIN) {
+        if (++fake_depth > fake_depth_max) fake_depth_max = fake_depth;
+        SPI1_Complete();
+        fake_depth--;
+    } else {
+        fake_pending = 1;
+    }
+}
+
+static const SPI1_BackendTypeDef fake_backend = { Fake_Select, Fake_Start };
+
+// DMA transfer-complete interrupt
+static void Fake_Irq(void) {
+    if (fake_pending) {
+        fake_pending = 0;
+        SPI1_Complete();
+    }
+}
+
+static void Fake_Reset(void) {
+    while (fake_pending) Fake_Irq();
+    fake_n = 0;
+    fake_depth = fake_depth_max = 0;
+    fake_byte = 0;
+}
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+static int Log_Is(const char *const *expect, int n) {
+    int i;
+    if (fake_n != n) return 0;
+    for (i = 0; i < n; i++) {
+        if (strcmp(fake_log[i], expect[i]) != 0) return 0;
+    }
+    return 1;
+}
+
+static void Log_Dump(void) {
+    int i;
+    printf("  log:");
+    for (i = 0; i < fake_n; i++) printf(" %s", fake_log[i]);
+    printf("\n");
+}
+
+static void Xfer_Init(SPI1_XferTypeDef *x, const uint8_t *tx, uint8_t *rx, uint16_t len,
+                      GPIO_TypeDef *port, uint16_t pin, uint8_t flags) {
+    memset(x, 0, sizeof(*x));
+    x->tx = tx;
+    x->rx = rx;
+    x->len = len;
+    x->cs_port = port;
+    x->cs_pin = pin;
+    x->flags = flags;
+}
+
+// A short transfer never touches DMA and is done when Submit returns
+static void Test_Polled(void) {
+    static const uint8_t tx[2] = { 0x80, 0x00 };
+    static const char *const expect[] = { "SA1", "T2:80", "DA1" };
+    uint8_t rx[2];
+    SPI1_XferTypeDef x;
+    int before = failures;
+
+    printf("polled transfer\n");
+    Fake_Reset();
+    Xfer_Init(&x, tx, rx, 2, GPIOA, GPIO_Pin_0, 0);
+    SPI1_Submit(&x);
+    CHECK(x.status == SPI1_XFER_DONE);
+    CHECK(rx[0] == 0 && rx[1] == 1);
+    CHECK(SPI1_Idle());
+    CHECK(Log_Is(expect, 3));
+    if (failures != before) Log_Dump();
+}
+
+// Transfers queued behind a DMA transfer run in submission order once it ends
+static void Test_Order(void) {
+    static const uint8_t a[8] = { 0xA0 }, b[2] = { 0xB0 }, c[8] = { 0xC0 };
+    static const char *const expect[] = {
+        "SA1", "T8:A0", "DA1", "SA4", "T2:B0", "DA4", "SC256", "T8:C0", "DC256"
+    };
+    SPI1_XferTypeDef xa, xb, xc;
+    int before = failures;
+
+    printf("submission order behind DMA\n");
+    Fake_Reset();
+    Xfer_Init(&xa, a, 0, 8, GPIOA, GPIO_Pin_0, 0);
+    Xfer_Init(&xb, b, 0, 2, GPIOA, GPIO_Pin_2, 0);
+    Xfer_Init(&xc, c, 0, 8, GPIOC, GPIO_Pin_8, 0);
+    SPI1_Submit(&xa);
+    SPI1_Submit(&xb);
+    SPI1_Submit(&xc);
+    CHECK(xa.status == SPI1_XFER_ACTIVE);
+    CHECK(xb.status == SPI1_XFER_QUEUED && xc.status == SPI1_XFER_QUEUED);
+    CHECK(fake_n == 2);             // Nothing but A on the bus yet
+
+    Fake_Irq();                     // A done: B polls inline, C goes to DMA
+    CHECK(xa.status == SPI1_XFER_DONE && xb.status == SPI1_XFER_DONE);
+    CHECK(xc.status == SPI1_XFER_ACTIVE);
+    Fake_Irq();
+    CHECK(xc.status == SPI1_XFER_DONE);
+    CHECK(SPI1_Idle());
+    CHECK(Log_Is(expect, 9));
+    if (failures != before) Log_Dump();
+}
+
+// Polled transfers complete from inside backend->start; spi1_kicking must turn
+// the nested SPI1_Kick into a no-op so a long queue does not recurse
+static void Test_Reentrant(void) {
+    static const uint8_t tx[3] = { 0x11, 0x22, 0x33 };
+    SPI1_XferTypeDef x[10];
+    int i;
+
+    printf("re-entrant completion (polled chain)\n");
+    Fake_Reset();
+    Xfer_Init(&x[0], tx, 0, 8, GPIOA, GPIO_Pin_0, 0);
+    SPI1_Submit(&x[0]);             // Hold the bus while the rest queue up
+    for (i = 1; i < 10; i++) {
+        Xfer_Init(&x[i], tx, 0, 3, GPIOA, GPIO_Pin_0, 0);
+        SPI1_Submit(&x[i]);
+    }
+    Fake_Irq();
+    for (i = 0; i < 10; i++) CHECK(x[i].status == SPI1_XFER_DONE);
+    CHECK(fake_depth_max == 1);     // Each polled completion returned before the next start
+    CHECK(SPI1_Idle());
+}
+
+// SPI1_KEEP_CS chains two transfers into one chip-select window
+static void Test_KeepCs(void) {
+    static const uint8_t addr[1] = { 0x92 }, data[6] = { 0x01 };
+    static const char *const expect[] = { "SA2", "T1:92", "SA2", "T6:01", "DA2" };
+    SPI1_XferTypeDef xa, xd;
+    int before = failures;
+
+    printf("chained chip select\n");
+    Fake_Reset();
+    Xfer_Init(&xa, addr, 0, 1, GPIOA, GPIO_Pin_1, SPI1_KEEP_CS);
+    Xfer_Init(&xd, data, 0, 6, GPIOA, GPIO_Pin_1, 0);
+    SPI1_Submit(&xa);
+    SPI1_Submit(&xd);
+    Fake_Irq();
+    CHECK(xa.status == SPI1_XFER_DONE && xd.status == SPI1_XFER_DONE);
+    CHECK(Log_Is(expect, 5));
+    if (failures != before) Log_Dump();
+}
+
+// A completion callback may queue the next transfer; it runs after what was
+// already queued
+static SPI1_XferTypeDef cb_next;
+static int cb_order[3], cb_n;
+
+static void Cb_Done(SPI1_XferTypeDef *x) {
+    cb_order[cb_n++] = (int)(long)x->ctx;
+    if (x->ctx == (void *)1) SPI1_Submit(&cb_next);
+}
+
+static void Test_Callback(void) {
+    static const uint8_t tx[4] = { 0x42 };
+    SPI1_XferTypeDef x1, x2;
+
+    printf("submit from a completion callback\n");
+    Fake_Reset();
+    cb_n = 0;
+    Xfer_Init(&x1, tx, 0, 4, 0, 0, 0);
+    Xfer_Init(&x2, tx, 0, 2, 0, 0, 0);
+    Xfer_Init(&cb_next, tx, 0, 2, 0, 0, 0);
+    x1.done = x2.done = cb_next.done = Cb_Done;
+    x1.ctx = (void *)1;
+    x2.ctx = (void *)2;
+    cb_next.ctx = (void *)3;
+    SPI1_Submit(&x1);
+    SPI1_Submit(&x2);
+    Fake_Irq();
+    CHECK(cb_n == 3);
+    CHECK(cb_order[0] == 1 && cb_order[1] == 2 && cb_order[2] == 3);
+    CHECK(fake_n == 3);             // No chip select: only the three transfers
+    CHECK(SPI1_Idle());
+}
+
+int main(void) {
+    SPI1_SetBackend(&fake_backend);
+
+    Test_Polled();
+    Test_Order();
+    Test_Reentrant();
+    Test_KeepCs();
+    Test_Callback();
+
+    printf("%s (%d failures)\n", failures ? "FAILED" : "passed", failures);
+    return failures ? 1 : 0;
+}
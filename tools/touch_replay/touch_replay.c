@@ -0,0 +1,285 @@
+/* tools/touch_replay/touch_replay.c
+ *
+ * Replays a touch capture (UART "CAPTURE ON" stream, see touch.c) through
+ * the unmodified filtering, calibration and gesture code on the host.
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -DTOUCH_HOST -Itools/host -ILibraries/LCD \
+ *       tools/touch_replay/touch_replay.c Libraries/LCD/touch.c \
+ *       Libraries/LCD/gesture.c -lm -o touch_replay
+ *
+ * Usage:
+ *   ./touch_replay capture.bin [-v]
+ *
+ * The stream is framed (sync byte, length and check, see touch.c), so text
+ * the device printed on the same UART is skipped by resyncing on the next
+ * valid frame. Each recorded sampler tick restores the pen state and feeds
+ * the recorded conversions back through ADS_Read_AD. If the filter asks for
+ * more samples of a channel than were captured, the last value is repeated
+ * (underrun); samples it no longer needs are skipped (unused).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "touch.h"
+#include "gesture.h"
+
+GPIO_TypeDef host_gpioc;
+
+#define MAX_CONV 64 // Conversions recorded in one tick
+
+typedef struct {
+    uint8_t cmd;
+    uint16_t val;
+    uint8_t used;
+} Replay_Conv;
+
+static Replay_Conv tick_conv[MAX_CONV];
+static int tick_count;
+static uint16_t last_val[16];
+
+static long stat_underrun, stat_unused, stat_lost, stat_skipped;
+
+#define CAP_SYNC 0xA5
+#define CAP_MIN 6           // Sync, len, type, time, check
+#define CAP_CAL 0xB0
+#define CAP_IDLE 0xC0
+#define CAP_TICK 0xE0
+#define CAP_DROP 0xF0
+
+static uint16_t Replay_Read_AD(uint8_t CMD) {
+    int i;
+    for (i = 0; i < tick_count; i++) {
+        if (!tick_conv[i].used && tick_conv[i].cmd == (CMD & 0xF0)) {
+            tick_conv[i].used = 1;
+            last_val[CMD >> 4] = tick_conv[i].val;
+            return tick_conv[i].val;
+        }
+    }
+    stat_underrun++;
+    return last_val[CMD >> 4];
+}
+
+static void Replay_Read_Burst(uint8_t CMD, uint16_t *buf, uint8_t n) {
+    uint8_t i;
+    for (i = 0; i < n; i++) buf[i] = Replay_Read_AD(CMD);
+}
+
+// [0xA5] len type t0 t1 payload.. ~(sum of len .. payload); 0 if not a frame
+static int Frame_Length(const uint8_t *p, long avail) {
+    uint8_t check = 0;
+    int len, i;
+
+    if (avail < CAP_MIN || p[0] != CAP_SYNC) return 0;
+    len = p[1];
+    if (len < CAP_MIN || len > avail) return 0;
+    switch (p[2]) {
+        case CAP_CAL:  if (len != CAP_MIN + 12) return 0; break;
+        case CAP_IDLE: if (len != CAP_MIN + 1) return 0; break;
+        case CAP_DROP: if (len != CAP_MIN + 2) return 0; break;
+        case CAP_TICK: case CAP_TICK | 1: break;
+        default: return 0;
+    }
+    for (i = 1; i < len - 1; i++) check += p[i];
+    check = ~check;
+    return check == p[len - 1] ? len : 0;
+}
+
+// Runs of cmd[7:4] | count[3:0], then count 12-bit values packed two per
+// 3 bytes; returns 0 if the runs do not fill the payload exactly
+static int Unpack_Tick(const uint8_t *p, int len) {
+    int pos = 5, end = len - 1, run, k;
+
+    tick_count = 0;
+    while (pos < end) {
+        uint8_t cmd = p[pos] & 0xF0;
+        run = p[pos++] & 0x0F;
+        if (run == 0 || pos + (run * 3 + 1) / 2 > end) return 0;
+        for (k = 0; k < run; k++) {
+            uint16_t v;
+            if (k & 1) {
+                v = (p[pos] & 0x0F) << 8 | p[pos + 1];
+                pos += 2;
+            } else {
+                v = p[pos] << 4 | p[pos + 1] >> 4;
+                pos += (k + 1 < run) ? 1 : 2;
+            }
+            if (tick_count < MAX_CONV) {
+                tick_conv[tick_count].cmd = cmd;
+                tick_conv[tick_count].val = v;
+                tick_conv[tick_count].used = 0;
+                tick_count++;
+            }
+        }
+    }
+    return pos == end;
+}
+
+// Noise: deviation of the middle sample of a stroke window from the window
+// mean. Steady finger motion moves the mean with the sample and cancels out.
+#define NOISE_WIN 5
+
+static double Noise_Deviation(const uint16_t *v) {
+    double mean = 0;
+    int i;
+    for (i = 0; i < NOISE_WIN; i++) mean += v[i];
+    mean /= NOISE_WIN;
+    return fabs(v[NOISE_WIN / 2] - mean);
+}
+
+static double Now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char *gesture_name[] = {
+    "none", "tap", "double-tap", "long-press",
+    "swipe-left", "swipe-right", "swipe-up", "swipe-down"
+};
+
+static int verbose;
+static long ticks, pen_ticks, accepted, rejected, ups;
+static long gestures[8];
+static long noise_n;
+static double noise_sum, cpu_ns;
+static int win_n;
+static uint16_t win_x[NOISE_WIN], win_y[NOISE_WIN];
+
+// One sampler tick on the conversions in tick_conv
+static void Replay_Tick(int pen) {
+    Touch_EventTypeDef ev;
+    Gesture_EventTypeDef g;
+    double t0;
+    int got_sample = 0;
+    int i;
+
+    host_gpioc.IDR = pen ? 0 : (1 << 5); // T_INT is low while pressed
+    t0 = Now_ns();
+    Touch_Sampler_Tick();
+    while (Touch_GetEvent(&ev)) {
+        if (ev.type == TOUCH_EVT_UP) {
+            ups++;
+            win_n = 0;
+        } else {
+            got_sample = 1;
+            accepted++;
+            if (win_n == NOISE_WIN) {
+                memmove(win_x, win_x + 1, sizeof(win_x) - sizeof(win_x[0]));
+                memmove(win_y, win_y + 1, sizeof(win_y) - sizeof(win_y[0]));
+                win_n--;
+            }
+            win_x[win_n] = ev.x;
+            win_y[win_n] = ev.y;
+            win_n++;
+            if (win_n == NOISE_WIN) {
+                noise_sum += Noise_Deviation(win_x) + Noise_Deviation(win_y);
+                noise_n++;
+            }
+        }
+        if (Gesture_Process(&ev, &g)) {
+            gestures[g.type]++;
+            if (verbose) printf("%8u ms  %-11s %3u,%3u\n", (unsigned)g.time, gesture_name[g.type], g.x, g.y);
+        }
+    }
+    if (Gesture_Tick(Touch_GetTime(), &g)) {
+        gestures[g.type]++;
+        if (verbose) printf("%8u ms  %-11s %3u,%3u\n", (unsigned)g.time, gesture_name[g.type], g.x, g.y);
+    }
+    cpu_ns += Now_ns() - t0;
+
+    ticks++;
+    if (pen) {
+        pen_ticks++;
+        if (!got_sample) rejected++;
+    }
+    for (i = 0; i < tick_count; i++) {
+        if (!tick_conv[i].used) stat_unused++;
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *f;
+    uint8_t *data;
+    long size, pos;
+    int len, i;
+
+    verbose = (argc > 2 && strcmp(argv[2], "-v") == 0);
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.bin [-v]\n", argv[0]);
+        return 1;
+    }
+    f = fopen(argv[1], "rb");
+    if (!f) { perror(argv[1]); return 1; }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size + 4);
+    if (!data || fread(data, 1, size, f) != (size_t)size) { fprintf(stderr, "read failed\n"); return 1; }
+    fclose(f);
+
+    // Calibration frame : xfac yfac xoff yoff
+    for (pos = 0; pos < size; pos++) {
+        len = Frame_Length(data + pos, size - pos);
+        if (len && data[pos + 2] == CAP_CAL) break;
+    }
+    if (pos >= size) { fprintf(stderr, "no calibration frame\n"); return 1; }
+    memcpy(&xfac, data + pos + 5, 4);
+    memcpy(&yfac, data + pos + 9, 4);
+    xoff = (short)(data[pos + 13] | data[pos + 14] << 8);
+    yoff = (short)(data[pos + 15] | data[pos + 16] << 8);
+    pos += len;
+
+    printf("calibration: xfac=%f yfac=%f xoff=%d yoff=%d\n", xfac, yfac, xoff, yoff);
+
+    Touch_Transport_Custom(Replay_Read_AD, Replay_Read_Burst);
+    Gesture_Init(0);
+
+    while (pos < size) {
+        const uint8_t *p = data + pos;
+
+        len = Frame_Length(p, size - pos);
+        if (!len || ((p[2] & 0xF0) == CAP_TICK && !Unpack_Tick(p, len))) {
+            pos++;                  // Text or a damaged frame: resync
+            stat_skipped++;
+            continue;
+        }
+        pos += len;
+
+        switch (p[2]) {
+            case CAP_TICK:
+            case CAP_TICK | 1:
+                Replay_Tick(p[2] & 1);
+                break;
+            case CAP_IDLE:
+                tick_count = 0;
+                for (i = 0; i < p[5]; i++) Replay_Tick(0);
+                break;
+            case CAP_DROP:
+                stat_lost += p[5] | p[6] << 8;
+                break;
+            default:
+                break;
+        }
+    }
+
+    printf("ticks            : %ld (%ld pen down)\n", ticks, pen_ticks);
+    printf("samples accepted : %ld\n", accepted);
+    printf("samples rejected : %ld (pen down, no event)\n", rejected);
+    printf("strokes          : %ld\n", ups);
+    printf("noise            : %.2f px mean |dx|+|dy| from a %d-sample centred average\n",
+           noise_n ? noise_sum / noise_n : 0.0, NOISE_WIN);
+    printf("gestures         : tap %ld, double %ld, long %ld, swipe L/R/U/D %ld/%ld/%ld/%ld\n",
+           gestures[1], gestures[2], gestures[3], gestures[4], gestures[5], gestures[6], gestures[7]);
+    printf("cpu per tick     : %.0f ns\n", ticks ? cpu_ns / ticks : 0.0);
+    printf("cpu per event    : %.0f ns\n", (accepted + ups) ? cpu_ns / (accepted + ups) : 0.0);
+    printf("conversions      : %ld underrun, %ld unused, %ld ticks dropped on device\n",
+           stat_underrun, stat_unused, stat_lost);
+    printf("stream           : %ld bytes skipped (text, damaged frames)\n", stat_skipped);
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/* Core/Src/admin.c */
+#include "admin.h"
+#include "ds3231.h"
+#include "lcd.h"
+#include "touch.h"
+#include "gesture.h"
+#include <stdio.h>
+
+// Attendance times owned by main.c
+extern uint8_t att_hour, att_min, att_sec;
+extern uint8_t late_hour, late_min, late_sec;
+extern uint8_t dead_hour, dead_min, dead_sec;
+
+// Widget IDs
+#define W_ROW_ATT   0
+#define W_ROW_LATE  1
+#define W_ROW_DEAD  2
+#define W_H_DN      3
+#define W_H_UP      4
+#define W_M_DN      5
+#define W_M_UP      6
+#define W_S_DN      7
+#define W_S_UP      8
+#define W_SAVE      9
+#define W_EXIT      10
+
+static const Hit_WidgetTypeDef admin_widgets[] = {
+    { 10,  40, 229,  71, W_ROW_ATT  },
+    { 10,  80, 229, 111, W_ROW_LATE },
+    { 10, 120, 229, 151, W_ROW_DEAD },
+    {  0, 170,  39, 209, W_H_DN },
+    { 40, 170,  79, 209, W_H_UP },
+    { 80, 170, 119, 209, W_M_DN },
+    {120, 170, 159, 209, W_M_UP },
+    {160, 170, 199, 209, W_S_DN },
+    {200, 170, 239, 209, W_S_UP },
+    { 20, 240, 109, 279, W_SAVE },
+    {130, 240, 219, 279, W_EXIT },
+};
+#define ADMIN_WIDGETS (sizeof(admin_widgets) / sizeof(admin_widgets[0]))
+
+static const char *admin_button_label[] = { "H-", "H+", "M-", "M+", "S-", "S+" };
+static const char *admin_row_label[] = { "ATT", "LAT", "DED" };
+static const uint8_t admin_limit[3] = { 24, 60, 60 }; // hour, min, sec
+
+static const Gesture_ConfigTypeDef admin_gesture = {
+    700,    // long_press_ms
+    300,    // double_tap_ms
+    12,     // move_tol
+    40      // swipe_min
+};
+
+// Unlock code: after the long-press, these swipes in order within
+// ADMIN_UNLOCK_MS; change it per installation
+static const uint8_t admin_code[] = {
+    GESTURE_SWIPE_UP, GESTURE_SWIPE_UP, GESTURE_SWIPE_LEFT, GESTURE_SWIPE_DOWN
+};
+#define ADMIN_CODE_LEN (sizeof(admin_code) / sizeof(admin_code[0]))
+
+static Hit_IndexTypeDef admin_index;
+static uint8_t admin_open = 0;
+static uint8_t admin_armed = 0;     // Long-press seen, waiting for the code
+static uint8_t admin_code_pos;
+static uint8_t admin_fails = 0;
+static uint32_t admin_arm_time;     // Sampler clock of the long-press
+static uint32_t admin_lock_time;    // Sampler clock of the last lockout
+static uint8_t admin_row = 0;
+static uint8_t admin_edit[3][3];    // [row][hour, min, sec]
+
+static void Admin_DrawRow(uint8_t row) {
+    char buf[20];
+    sprintf(buf, "%s  %02d:%02d:%02d", admin_row_label[row],
+            admin_edit[row][0], admin_edit[row][1], admin_edit[row][2]);
+    LCD_ShowString(30, admin_widgets[row].y0 + 8, (uint8_t*)buf,
+                   (row == admin_row) ? RED : BLACK, WHITE);
+}
+
+static void Admin_DrawButton(const Hit_WidgetTypeDef *w, const char *label) {
+    uint16_t len = 0;
+    while (label[len]) len++;
+    LCD_DrawRectangle(w->x0, w->y0, w->x1, w->y1);
+    LCD_ShowString((w->x0 + w->x1 + 1) / 2 - len * 4, (w->y0 + w->y1 + 1) / 2 - 8,
+                   (uint8_t*)label, BLACK, WHITE);
+}
+
+static void Admin_Draw(void) {
+    uint8_t i;
+    LCD_Clear(WHITE);
+    LCD_ShowString(30, 10, (uint8_t*)"ADMIN MENU", BLUE, WHITE);
+    for (i = 0; i < 3; i++) {
+        Admin_DrawRow(i);
+    }
+    for (i = 0; i < 6; i++) {
+        Admin_DrawButton(&admin_widgets[W_H_DN + i], admin_button_label[i]);
+    }
+    Admin_DrawButton(&admin_widgets[W_SAVE], "SAVE");
+    Admin_DrawButton(&admin_widgets[W_EXIT], "EXIT");
+}
+
+static void Admin_Open(void) {
+    admin_edit[0][0] = att_hour;  admin_edit[0][1] = att_min;  admin_edit[0][2] = att_sec;
+    admin_edit[1][0] = late_hour; admin_edit[1][1] = late_min; admin_edit[1][2] = late_sec;
+    admin_edit[2][0] = dead_hour; admin_edit[2][1] = dead_min; admin_edit[2][2] = dead_sec;
+    admin_row = 0;
+    admin_open = 1;
+    Admin_Draw();
+}
+
+static void Admin_Save(void) {
+    att_hour  = admin_edit[0][0]; att_min  = admin_edit[0][1]; att_sec  = admin_edit[0][2];
+    late_hour = admin_edit[1][0]; late_min = admin_edit[1][1]; late_sec = admin_edit[1][2];
+    dead_hour = admin_edit[2][0]; dead_min = admin_edit[2][1]; dead_sec = admin_edit[2][2];
+    DS3231_SetAlarm1(att_hour, att_min, att_sec);
+    DS3231_SetAlarm2(late_hour, late_min, late_sec);
+    DS3231_SetAlarm3(dead_hour, dead_min, dead_sec);
+}
+
+static void Admin_SelectRow(uint8_t row) {
+    uint8_t prev = admin_row;
+    admin_row = row;
+    Admin_DrawRow(prev);
+    Admin_DrawRow(row);
+}
+
+// Returns ADMIN_xxx result of the gesture while the menu is open
+static uint8_t Admin_Handle(const Gesture_EventTypeDef *g) {
+    int16_t id;
+    uint8_t field;
+
+    switch (g->type) {
+        case GESTURE_TAP:
+        case GESTURE_DOUBLE_TAP:
+            id = Hit_Test(&admin_index, g->x, g->y);
+            if (id < 0) break;
+            if (id <= W_ROW_DEAD) {
+                Admin_SelectRow(id);
+            } else if (id <= W_S_UP) {
+                field = (id - W_H_DN) / 2;
+                if ((id - W_H_DN) & 1) {
+                    admin_edit[admin_row][field] = (admin_edit[admin_row][field] + 1) % admin_limit[field];
+                } else {
+                    admin_edit[admin_row][field] = (admin_edit[admin_row][field] + admin_limit[field] - 1) % admin_limit[field];
+                }
+                Admin_DrawRow(admin_row);
+            } else if (id == W_SAVE) {
+                Admin_Save();
+                admin_open = 0;
+                return ADMIN_SAVED;
+            } else {
+                admin_open = 0;
+                return ADMIN_CLOSED;
+            }
+            break;
+        case GESTURE_SWIPE_UP:
+            Admin_SelectRow((admin_row + 2) % 3);
+            break;
+        case GESTURE_SWIPE_DOWN:
+            Admin_SelectRow((admin_row + 1) % 3);
+            break;
+        case GESTURE_SWIPE_RIGHT:
+            admin_open = 0;
+            return ADMIN_CLOSED;
+        default:
+            break;
+    }
+    return ADMIN_NONE;
+}
+
+void Admin_Init(void) {
+    Hit_Build(&admin_index, admin_widgets, ADMIN_WIDGETS);
+    Gesture_Init(&admin_gesture);
+}
+
+// Outside the menu: long-press arms, then the swipe code opens it. A wrong
+// or late gesture disarms silently; ADMIN_UNLOCK_TRIES wrong codes lock the
+// gate for ADMIN_LOCKOUT_MS. Returns 1 when the menu should open
+static uint8_t Admin_Unlock(const Gesture_EventTypeDef *g) {
+    if (admin_fails >= ADMIN_UNLOCK_TRIES) {
+        if ((g->time - admin_lock_time) < ADMIN_LOCKOUT_MS) return 0;
+        admin_fails = 0;
+    }
+
+    if (g->type == GESTURE_LONG_PRESS) {
+        admin_armed = 1;
+        admin_code_pos = 0;
+        admin_arm_time = g->time;
+        return 0;
+    }
+    if (!admin_armed) return 0;
+
+    if ((g->time - admin_arm_time) >= ADMIN_UNLOCK_MS || g->type != admin_code[admin_code_pos]) {
+        admin_armed = 0;
+        if (++admin_fails >= ADMIN_UNLOCK_TRIES) admin_lock_time = g->time;
+        return 0;
+    }
+    if (++admin_code_pos < ADMIN_CODE_LEN) return 0;
+
+    admin_armed = 0;
+    admin_fails = 0;
+    return 1;
+}
+
+// Drain touch events; long-press plus the swipe code opens the menu
+uint8_t Admin_Poll(void) {
+    Touch_EventTypeDef ev;
+    Gesture_EventTypeDef g;
+    uint8_t result = ADMIN_NONE;
+    uint8_t got;
+
+    do {
+        got = Touch_GetEvent(&ev);
+        if (got) {
+            if (!Gesture_Process(&ev, &g)) continue;
+        } else if (!Gesture_Tick(Touch_GetTime(), &g)) {
+            break;
+        }
+
+        if (admin_open) {
+            result = Admin_Handle(&g);
+        } else if (Admin_Unlock(&g)) {
+            Admin_Open();
+            result = ADMIN_OPENED;
+        }
+    } while (got && result == ADMIN_NONE);
+
+    return result;
+}
+
+uint8_t Admin_IsOpen(void) {
+    return admin_open;
+}
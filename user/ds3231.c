@@ -1,8 +1,8 @@
 #include "ds3231.h"
+#include "i2c1.h"
 #include "stm32f10x.h"
 
-// Define I2C Interface
-#define DS3231_I2C I2C1
+extern volatile uint32_t sys_tick_ms;
 
 // Register Definitions
 #define DS3231_CONTROL_REG 0x0E
@@ -14,193 +14,58 @@
 uint8_t decToBcd(int val) { return (uint8_t)( (val/10*16) + (val%10) ); }
 int bcdToDec(uint8_t val) { return (int)( (val/16*10) + (val%16) ); }
 
-#define DS3231_TIMEOUT 20000
 static uint8_t DS3231_I2C_Error = 0;
 
-// Low-level I2C Write
-void DS3231_WriteReg(uint8_t reg, uint8_t val) {
-    if (DS3231_I2C_Error) return;
-
-    uint32_t timeout = DS3231_TIMEOUT;
-    while(I2C_GetFlagStatus(DS3231_I2C, I2C_FLAG_BUSY)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
+// Register 0x00..0x12
+#define DS3231_NUM_REGS 0x13
 
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Transmitter);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    // Send Register Address
-    I2C_SendData(DS3231_I2C, reg);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
+// Every access is one I2C1 transaction: register address (+ data) written,
+// then count bytes read after a repeated START. The engine runs it from the
+// I2C interrupts; the caller sleeps until it is done.
+static void DS3231_Xfer(uint8_t reg, const uint8_t *data, uint8_t *buf, uint16_t count) {
+    uint8_t tx[1 + DS3231_NUM_REGS];
+    I2C1_XferTypeDef x;
+    uint16_t i;
 
-    // Send Value
-    I2C_SendData(DS3231_I2C, val);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
+    if (DS3231_I2C_Error) return;
+    if (count > DS3231_NUM_REGS) { DS3231_I2C_Error = 1; return; }
+
+    tx[0] = reg;
+    for (i = 0; data && i < count; i++) {
+        tx[1 + i] = data[i];
+    }
+    x.addr = DS3231_ADDRESS;
+    x.tx = tx;
+    x.tx_len = data ? 1 + count : 1;
+    x.rx = buf;
+    x.rx_len = data ? 0 : count;
+    x.done = 0;
+    x.ctx = 0;
+    if (I2C1_Transfer(&x) != I2C1_XFER_DONE) {
+        DS3231_I2C_Error = 1;
     }
+}
 
-    // Generate Stop
-    I2C_GenerateSTOP(DS3231_I2C, ENABLE);
+// Low-level I2C Write
+void DS3231_WriteReg(uint8_t reg, uint8_t val) {
+    DS3231_Xfer(reg, &val, 0, 1);
 }
 
 // Low-level I2C Read
 uint8_t DS3231_ReadReg(uint8_t reg) {
-    if (DS3231_I2C_Error) return 0;
-    
     uint8_t val = 0;
-    uint32_t timeout = DS3231_TIMEOUT;
-    
-    while(I2C_GetFlagStatus(DS3231_I2C, I2C_FLAG_BUSY)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Transmitter);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_SendData(DS3231_I2C, reg);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Receiver);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-
-    I2C_AcknowledgeConfig(DS3231_I2C, DISABLE);
-    I2C_GenerateSTOP(DS3231_I2C, ENABLE);
-
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_RECEIVED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return 0; }
-    }
-    val = I2C_ReceiveData(DS3231_I2C);
-    
-    I2C_AcknowledgeConfig(DS3231_I2C, ENABLE);
-    
+    DS3231_Xfer(reg, 0, &val, 1);
     return val;
 }
 
 // Burst Read
 void DS3231_ReadBurst(uint8_t reg, uint8_t *buf, uint16_t count) {
-    if (DS3231_I2C_Error) return;
-
-    uint32_t timeout = DS3231_TIMEOUT;
-    while(I2C_GetFlagStatus(DS3231_I2C, I2C_FLAG_BUSY)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Transmitter);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_SendData(DS3231_I2C, reg);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Receiver);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    for(int i = 0; i < count; i++) {
-        if(i == count - 1) {
-            I2C_AcknowledgeConfig(DS3231_I2C, DISABLE);
-            I2C_GenerateSTOP(DS3231_I2C, ENABLE);
-        }
-        
-        timeout = DS3231_TIMEOUT;
-        while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_RECEIVED)) {
-            if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-        }
-        buf[i] = I2C_ReceiveData(DS3231_I2C);
-    }
-    I2C_AcknowledgeConfig(DS3231_I2C, ENABLE);
+    DS3231_Xfer(reg, 0, buf, count);
 }
 
 // Burst Write (Used for Time Set)
 void DS3231_WriteBurst(uint8_t reg, uint8_t *buf, uint16_t count) {
-    if (DS3231_I2C_Error) return;
-
-    uint32_t timeout = DS3231_TIMEOUT;
-    while(I2C_GetFlagStatus(DS3231_I2C, I2C_FLAG_BUSY)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_GenerateSTART(DS3231_I2C, ENABLE);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_Send7bitAddress(DS3231_I2C, DS3231_ADDRESS, I2C_Direction_Transmitter);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    I2C_SendData(DS3231_I2C, reg);
-    timeout = DS3231_TIMEOUT;
-    while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-    }
-
-    for(int i=0; i<count; i++) {
-        I2C_SendData(DS3231_I2C, buf[i]);
-        timeout = DS3231_TIMEOUT;
-        while(!I2C_CheckEvent(DS3231_I2C, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-            if((timeout--) == 0) { DS3231_I2C_Error = 1; return; }
-        }
-    }
-    
-    I2C_GenerateSTOP(DS3231_I2C, ENABLE);
+    DS3231_Xfer(reg, buf, 0, count);
 }
 
 void DS3231_Init(RTC_TimeTypeDef *rtc_time) {
@@ -213,14 +78,9 @@ void DS3231_Init(RTC_TimeTypeDef *rtc_time) {
     rtc_time->dayofmonth = 10;   // 날짜
     rtc_time->month      = 12;   // 월
     rtc_time->year       = 25;   // 2024 -> 24
-
-    I2C_AcknowledgeConfig(DS3231_I2C, ENABLE);
 }
 
-void DS3231_GetTime(RTC_TimeTypeDef *rtc_time) {
-    uint8_t buffer[7];
-    DS3231_ReadBurst(0x00, buffer, 7);
-
+static void DS3231_DecodeTime(const uint8_t *buffer, RTC_TimeTypeDef *rtc_time) {
     rtc_time->seconds = bcdToDec(buffer[0]);
     rtc_time->minutes = bcdToDec(buffer[1]);
     rtc_time->hours   = bcdToDec(buffer[2]);
@@ -230,6 +90,50 @@ void DS3231_GetTime(RTC_TimeTypeDef *rtc_time) {
     rtc_time->year    = bcdToDec(buffer[6]);
 }
 
+void DS3231_GetTime(RTC_TimeTypeDef *rtc_time) {
+    uint8_t buffer[7];
+    DS3231_ReadBurst(0x00, buffer, 7);
+    DS3231_DecodeTime(buffer, rtc_time);
+}
+
+// Background clock read for the main loop
+static I2C1_XferTypeDef ds_time_xfer;
+static const uint8_t ds_time_reg = 0x00;
+static uint8_t ds_time_buf[7];
+static uint32_t ds_time_start;
+
+// Never waits: takes the read queued by the previous call (if it has finished)
+// and queues the next one. Returns 1 when rtc_time was updated.
+uint8_t DS3231_PollTime(RTC_TimeTypeDef *rtc_time) {
+    uint8_t updated = 0;
+
+    if (ds_time_xfer.status == I2C1_XFER_QUEUED || ds_time_xfer.status == I2C1_XFER_ACTIVE) {
+        if ((sys_tick_ms - ds_time_start) >= I2C1_TIMEOUT_MS) {
+            I2C1_Abort();       // Nothing else is waiting on the bus here: ours is stuck
+        }
+        return 0;
+    }
+    if (ds_time_xfer.status == I2C1_XFER_DONE) {
+        DS3231_DecodeTime(ds_time_buf, rtc_time);
+        updated = 1;
+    } else if (ds_time_xfer.status == I2C1_XFER_ERROR) {
+        DS3231_I2C_Error = 1;
+    }
+    ds_time_xfer.status = I2C1_XFER_IDLE;
+    if (DS3231_I2C_Error) return updated;
+
+    ds_time_xfer.addr = DS3231_ADDRESS;
+    ds_time_xfer.tx = &ds_time_reg;
+    ds_time_xfer.tx_len = 1;
+    ds_time_xfer.rx = ds_time_buf;
+    ds_time_xfer.rx_len = 7;
+    ds_time_xfer.done = 0;
+    ds_time_xfer.ctx = 0;
+    ds_time_start = sys_tick_ms;
+    I2C1_Submit(&ds_time_xfer);
+    return updated;
+}
+
 void DS3231_SetTime(RTC_TimeTypeDef *rtc_time) {
     uint8_t buffer[7];
     buffer[0] = decToBcd(rtc_time->seconds);
@@ -0,0 +1,246 @@
+/* Core/Src/i2c1.c */
+#include "i2c1.h"
+#include "stm32f10x.h"
+
+// Queued master transactions on I2C1, one at a time, in submission order.
+// Every step (START, address, each byte, STOP) is driven from the event and
+// error interrupts, so the CPU only spends a few microseconds per byte.
+// Reception follows the ST method for 1, 2 and N>2 bytes (AN2824): ACK and
+// STOP are set while the clock is stretched, so interrupt latency is harmless.
+
+extern volatile uint32_t sys_tick_ms;
+
+static I2C1_XferTypeDef *i2c1_head = 0;
+static I2C1_XferTypeDef *i2c1_tail = 0;
+static I2C1_XferTypeDef * volatile i2c1_active = 0;
+static uint8_t i2c1_pos;        // Bytes done in the current phase
+static uint8_t i2c1_reading;    // 0: write phase, 1: read phase
+static uint8_t i2c1_wait_sb;    // START requested, nothing else counts until SB
+
+// A STOP takes one bit time to leave the bus, a new START has to wait for it
+#define I2C1_STOP_SPIN      1000
+
+#define I2C1_SR1_ERRORS     (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR | I2C_SR1_TIMEOUT)
+
+static void I2C1_Start(I2C1_XferTypeDef *x) {
+    uint16_t spin = I2C1_STOP_SPIN;
+
+    while ((I2C1->CR1 & I2C_CR1_STOP) && spin--);
+    i2c1_pos = 0;
+    i2c1_reading = (x->tx_len == 0);
+    i2c1_wait_sb = 1;
+    I2C1->CR1 &= ~I2C_CR1_POS;
+    I2C1->CR1 |= I2C_CR1_ACK;
+    I2C1->CR2 |= I2C_CR2_ITEVTEN;       // ITBUF from ADDR on, where the phase needs it
+    I2C1->CR1 |= I2C_CR1_START;
+}
+
+// Start the next queued transaction if the bus is free
+static void I2C1_Kick(void) {
+    I2C1_XferTypeDef *x;
+
+    __disable_irq();
+    while (!i2c1_active && i2c1_head) {
+        x = i2c1_head;
+        i2c1_head = x->next;
+        if (!i2c1_head) i2c1_tail = 0;
+        if (x->tx_len == 0 && x->rx_len == 0) {
+            x->status = I2C1_XFER_DONE;     // Nothing to send, never touches the bus
+            if (x->done) x->done(x);
+            continue;
+        }
+        x->status = I2C1_XFER_ACTIVE;
+        i2c1_active = x;
+        I2C1_Start(x);
+    }
+    __enable_irq();
+}
+
+static void I2C1_Finish(uint8_t status) {
+    I2C1_XferTypeDef *x = i2c1_active;
+
+    I2C1->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+    I2C1->CR1 &= ~I2C_CR1_POS;
+    I2C1->CR1 |= I2C_CR1_ACK;
+    i2c1_active = 0;
+    if (!x) return;
+    x->status = status;
+    if (x->done) x->done(x);
+    I2C1_Kick();
+}
+
+// Write phase done: repeated START for the read phase, or STOP
+static void I2C1_EndWrite(I2C1_XferTypeDef *x) {
+    if (x->rx_len) {
+        // BTF stays set until the repeated START is on the bus (a few us)
+        i2c1_reading = 1;
+        i2c1_pos = 0;
+        i2c1_wait_sb = 1;
+        I2C1->CR1 |= I2C_CR1_START;
+    } else {
+        I2C1->CR1 |= I2C_CR1_STOP;
+        I2C1_Finish(I2C1_XFER_DONE);
+    }
+}
+
+void I2C1_EV_IRQHandler(void) {
+    I2C1_XferTypeDef *x = i2c1_active;
+    uint16_t sr1 = I2C1->SR1;
+    uint8_t rem;
+
+    if (!x) {
+        I2C1->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+        return;
+    }
+
+    if (i2c1_wait_sb) {
+        if (sr1 & I2C_SR1_SB) {
+            i2c1_wait_sb = 0;
+            I2C1->DR = i2c1_reading ? (x->addr | 0x01) : (x->addr & 0xFE);  // Clears SB
+        }
+        return;
+    }
+
+    if (sr1 & I2C_SR1_ADDR) {
+        if (!i2c1_reading) {
+            (void)I2C1->SR2;                // Clears ADDR
+            I2C1->DR = x->tx[i2c1_pos++];
+            if (i2c1_pos < x->tx_len) I2C1->CR2 |= I2C_CR2_ITBUFEN;    // Else next: BTF
+        } else if (x->rx_len == 1) {
+            I2C1->CR1 &= ~I2C_CR1_ACK;      // NACK the only byte
+            (void)I2C1->SR2;
+            I2C1->CR1 |= I2C_CR1_STOP;
+            I2C1->CR2 |= I2C_CR2_ITBUFEN;
+        } else if (x->rx_len == 2) {
+            I2C1->CR1 |= I2C_CR1_POS;       // NACK applies to the second byte
+            (void)I2C1->SR2;
+            I2C1->CR1 &= ~I2C_CR1_ACK;      // Next: BTF with both bytes in
+        } else {
+            (void)I2C1->SR2;
+            if (x->rx_len > 3) I2C1->CR2 |= I2C_CR2_ITBUFEN;           // Else next: BTF
+        }
+        return;
+    }
+
+    if (!i2c1_reading) {
+        if ((sr1 & I2C_SR1_TXE) && i2c1_pos < x->tx_len) {
+            I2C1->DR = x->tx[i2c1_pos++];
+            if (i2c1_pos >= x->tx_len) I2C1->CR2 &= ~I2C_CR2_ITBUFEN;
+        } else if (sr1 & I2C_SR1_BTF) {
+            I2C1_EndWrite(x);               // Last byte acknowledged
+        }
+        return;
+    }
+
+    rem = x->rx_len - i2c1_pos;
+    if (rem == 1 && (sr1 & I2C_SR1_RXNE)) {
+        x->rx[i2c1_pos++] = I2C1->DR;       // STOP is already set
+        I2C1_Finish(I2C1_XFER_DONE);
+    } else if (rem == 2 && (sr1 & I2C_SR1_BTF)) {
+        I2C1->CR1 |= I2C_CR1_STOP;
+        x->rx[i2c1_pos++] = I2C1->DR;
+        x->rx[i2c1_pos++] = I2C1->DR;
+        I2C1_Finish(I2C1_XFER_DONE);
+    } else if (rem == 3 && (sr1 & I2C_SR1_BTF)) {
+        // N-2 in DR, N-1 in the shift register, clock stretched: NACK the last byte
+        I2C1->CR1 &= ~I2C_CR1_ACK;
+        x->rx[i2c1_pos++] = I2C1->DR;
+        I2C1->CR1 |= I2C_CR1_STOP;
+        x->rx[i2c1_pos++] = I2C1->DR;
+        I2C1->CR2 |= I2C_CR2_ITBUFEN;       // Next: RXNE for the last byte
+    } else if (rem > 3 && (sr1 & I2C_SR1_RXNE)) {
+        x->rx[i2c1_pos++] = I2C1->DR;
+        if (rem == 4) I2C1->CR2 &= ~I2C_CR2_ITBUFEN;
+    }
+}
+
+void I2C1_ER_IRQHandler(void) {
+    uint16_t sr1 = I2C1->SR1;
+
+    I2C1->SR1 = (uint16_t)~(sr1 & I2C1_SR1_ERRORS);    // rc_w0
+    if (!(sr1 & I2C_SR1_ARLO)) {        // After lost arbitration the bus is not ours
+        I2C1->CR1 |= I2C_CR1_STOP;
+    }
+    I2C1_Finish(I2C1_XFER_ERROR);
+}
+
+void I2C1_Init(void) {
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    I2C1->CR2 |= I2C_CR2_ITERREN;
+
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_EV_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 2;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 2;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_ER_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+}
+
+// Stuck transaction (slave holding SDA, lost interrupt): fail it and reset the
+// peripheral, keeping the timing set up by I2C_Configuration
+void I2C1_Abort(void) {
+    uint16_t cr2, ccr, trise, oar1;
+
+    __disable_irq();
+    if (i2c1_active) {
+        cr2 = I2C1->CR2 & ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+        ccr = I2C1->CCR;
+        trise = I2C1->TRISE;
+        oar1 = I2C1->OAR1;
+        I2C1->CR1 |= I2C_CR1_SWRST;
+        I2C1->CR1 &= ~I2C_CR1_SWRST;
+        I2C1->CR2 = cr2;
+        I2C1->CCR = ccr;
+        I2C1->TRISE = trise;
+        I2C1->OAR1 = oar1;
+        I2C1->CR1 |= I2C_CR1_PE;
+        I2C1_Finish(I2C1_XFER_ERROR);
+    }
+    __enable_irq();
+}
+
+// Queue a transaction, returns at once; x must stay valid until DONE or ERROR
+void I2C1_Submit(I2C1_XferTypeDef *x) {
+    x->next = 0;
+    x->status = I2C1_XFER_QUEUED;
+    __disable_irq();
+    if (i2c1_tail) {
+        i2c1_tail->next = x;
+    } else {
+        i2c1_head = x;
+    }
+    i2c1_tail = x;
+    __enable_irq();
+    I2C1_Kick();
+}
+
+// Sleeps until the interrupts have finished x; each transaction ahead of it
+// (and x itself) gets I2C1_TIMEOUT_MS before the bus is reset
+uint8_t I2C1_Wait(I2C1_XferTypeDef *x) {
+    I2C1_XferTypeDef *cur = i2c1_active;
+    uint32_t start = sys_tick_ms;
+
+    while (x->status == I2C1_XFER_QUEUED || x->status == I2C1_XFER_ACTIVE) {
+        if (i2c1_active != cur) {
+            cur = i2c1_active;
+            start = sys_tick_ms;
+        } else if ((sys_tick_ms - start) >= I2C1_TIMEOUT_MS) {
+            I2C1_Abort();
+            start = sys_tick_ms;
+        }
+        __WFI();
+    }
+    return x->status;
+}
+
+// Blocking: queue and wait (earlier queued transactions go first)
+uint8_t I2C1_Transfer(I2C1_XferTypeDef *x) {
+    I2C1_Submit(x);
+    return I2C1_Wait(x);
+}
+
+uint8_t I2C1_Idle(void) {
+    return i2c1_active == 0 && i2c1_head == 0;
+}
@@ -0,0 +1,22 @@
+#ifndef __ADMIN_H
+#define __ADMIN_H
+
+#include "main.h"
+
+// Admin_Poll 결과
+#define ADMIN_NONE      0
+#define ADMIN_OPENED    1   // 메뉴 진입 (long-press + 스와이프 코드)
+#define ADMIN_CLOSED    2   // 저장 없이 종료
+#define ADMIN_SAVED     3   // 시간 설정 저장 후 종료
+
+// 메뉴 잠금 (코드는 admin.c의 admin_code)
+#define ADMIN_UNLOCK_MS     5000    // long-press 후 코드 입력 제한 시간
+#define ADMIN_UNLOCK_TRIES  3       // 연속 실패 허용 횟수
+#define ADMIN_LOCKOUT_MS    30000   // 초과 시 잠금 시간
+
+// 함수 원형
+void Admin_Init(void);
+uint8_t Admin_Poll(void);
+uint8_t Admin_IsOpen(void);
+
+#endif
@@ -21,6 +21,7 @@ typedef struct {
 // void DS3231_Init(I2C_HandleTypeDef *hi2c);
 void DS3231_Init(RTC_TimeTypeDef *rtc_time);
 void DS3231_GetTime(RTC_TimeTypeDef *rtc_time);
+uint8_t DS3231_PollTime(RTC_TimeTypeDef *rtc_time);     // 블로킹 없음: 이전 요청 결과 반영(1) + 다음 읽기 요청
 void DS3231_SetTime(RTC_TimeTypeDef *rtc_time);
 
 // 알람 설정용 구조체 및 함수 추가
@@ -0,0 +1,39 @@
+/* Core/Inc/i2c1.h */
+#ifndef __I2C1_H
+#define __I2C1_H
+
+#include "main.h"
+
+// 트랜잭션 상태
+#define I2C1_XFER_IDLE      0   // 아직 제출 안 됨
+#define I2C1_XFER_QUEUED    1
+#define I2C1_XFER_ACTIVE    2
+#define I2C1_XFER_DONE      3
+#define I2C1_XFER_ERROR     4   // NACK, 버스 오류, 중재 실패, 타임아웃
+
+// I2C1_Wait 제한 시간 (100kHz에서 8바이트 ~ 1ms)
+#define I2C1_TIMEOUT_MS     20
+
+// 트랜잭션 디스크립터 (호출자 소유, 완료 전까지 유효해야 함)
+// START - 주소(W) - tx - [반복 START - 주소(R) - rx] - STOP
+typedef struct I2C1_Xfer {
+    uint8_t addr;                   // 8비트 형식 주소 (R/W 비트 0)
+    const uint8_t *tx;              // 쓰기 단계 (보통 레지스터 주소 + 데이터)
+    uint8_t tx_len;                 // 0: 읽기만
+    uint8_t *rx;                    // 읽기 단계
+    uint8_t rx_len;                 // 0: 쓰기만
+    void (*done)(struct I2C1_Xfer *x);  // 완료 콜백 (I2C 인터럽트 문맥), NULL 가능
+    void *ctx;                      // 콜백용 사용자 데이터
+    volatile uint8_t status;        // I2C1_XFER_xxx
+    struct I2C1_Xfer *next;         // 큐 내부용
+} I2C1_XferTypeDef;
+
+// 함수 원형 (I2C1 자체는 main.c의 I2C_Configuration에서 설정)
+void I2C1_Init(void);
+void I2C1_Submit(I2C1_XferTypeDef *x);
+uint8_t I2C1_Wait(I2C1_XferTypeDef *x);        // DONE 또는 ERROR
+uint8_t I2C1_Transfer(I2C1_XferTypeDef *x);
+void I2C1_Abort(void);                         // 진행 중 트랜잭션 실패 처리 + 주변장치 리셋
+uint8_t I2C1_Idle(void);
+
+#endif
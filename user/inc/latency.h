@@ -0,0 +1,34 @@
+/* Core/Inc/latency.h */
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+#include "main.h"
+
+// 출석 처리 단계 (main.c RFID 분기)
+#define LAT_READ            0   // REQA 응답 ~ UID (안티콜리전/SELECT)
+#define LAT_LOOKUP          1   // UID ~ 이름 확인 (DB, 카드 레코드)
+#define LAT_LCD             2   // 결과 화면 그리기
+#define LAT_BEEP            3   // LED/부저 (블로킹)
+#define LAT_UART            4   // 출석 기록 전송
+#define LAT_TOTAL           5   // REQA 응답 ~ 전송 완료
+#define LAT_NUM_STAGES      6
+
+// 히스토그램: 버킷 k = [2^k, 2^(k+1)) us, 마지막 버킷은 그 이상 전부
+#define LAT_BUCKETS         22  // 1us ~ 2s
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t hist[LAT_BUCKETS];
+} Latency_StatsTypeDef;
+
+// 함수 원형
+void Latency_Init(void);                                    // DWT 사이클 카운터 시작
+uint32_t Latency_Now(void);                                 // 타임스탬프 (CPU 사이클)
+void Latency_Add(uint8_t stage, uint32_t start, uint32_t end);
+void Latency_GetStats(uint8_t stage, Latency_StatsTypeDef *st);
+uint32_t Latency_Percentile(const Latency_StatsTypeDef *st, uint8_t pct);  // us (버킷 상한)
+const char *Latency_Name(uint8_t stage);
+void Latency_Reset(void);
+
+#endif
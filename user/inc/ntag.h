@@ -0,0 +1,42 @@
+/* Core/Inc/ntag.h */
+#ifndef __NTAG_H
+#define __NTAG_H
+
+#include "main.h"
+#include "rc522.h"
+
+// MIFARE Ultralight / NTAG21x 명령어
+#define NTAG_CMD_GET_VERSION            0x60
+#define NTAG_CMD_READ                   0x30    // 4페이지 (16바이트)
+#define NTAG_CMD_FAST_READ              0x3A    // 시작~끝 페이지
+#define NTAG_CMD_PWD_AUTH               0x1B
+
+#define NTAG_PAGE_SIZE                  4
+#define NTAG_FAST_READ_MAX              15      // 한 번에 읽는 최대 페이지 (FIFO 64 = 60 + CRC_A)
+#define NTAG_USER_PAGE                  4       // 사용자 메모리 시작 페이지
+
+// 학생 레코드: 4~15페이지 (48바이트, 앞 32바이트는 Classic 레코드와 같은 형식)
+#define NTAG_RECORD_PAGE                NTAG_USER_PAGE
+#define NTAG_RECORD_PAGES               12
+
+// GET_VERSION 응답 (8바이트)
+typedef struct {
+    uint8_t header;     // 0x00
+    uint8_t vendor;     // 0x04: NXP
+    uint8_t type;       // 0x03: Ultralight, 0x04: NTAG
+    uint8_t subtype;
+    uint8_t major;
+    uint8_t minor;
+    uint8_t storage;    // 메모리 크기 코드 (NTAG_UserBytes)
+    uint8_t protocol;   // 0x03: ISO14443-3
+} NTAG_VersionTypeDef;
+
+// 함수 원형 (RC522_EVT_UID 직후, Ultralight/NTAG 카드가 선택된 상태에서 호출)
+uint8_t NTAG_GetVersion(NTAG_VersionTypeDef *ver);
+uint16_t NTAG_UserBytes(const NTAG_VersionTypeDef *ver);    // 0: 알 수 없음
+uint8_t NTAG_Read(uint8_t page, uint8_t *data);             // 16바이트
+uint8_t NTAG_FastRead(uint8_t start, uint8_t end, uint8_t *data);   // (end - start + 1) * 4바이트
+uint8_t NTAG_PwdAuth(const uint8_t *pwd, uint8_t *pack);    // pwd 4바이트, pack 2바이트 (NULL 가능)
+uint8_t NTAG_ReadRecord(const uint8_t *pwd, RC522_RecordTypeDef *rec);  // pwd NULL: 인증 생략
+
+#endif
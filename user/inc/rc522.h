@@ -70,6 +70,10 @@
 #define PICC_REQALL                     0x52
 #define PICC_ANTICOLL                   0x93
 #define PICC_SElECTTAG                  0x93
+#define PICC_ANTICOLL_CL2               0x95    // 캐스케이드 레벨 2 (7/10바이트 UID)
+#define PICC_ANTICOLL_CL3               0x97    // 캐스케이드 레벨 3 (10바이트 UID)
+#define PICC_CASCADE_TAG                0x88    // CT: 다음 레벨에 UID가 이어짐
+#define PICC_SAK_CASCADE                0x04    // SAK: UID 미완료
 #define PICC_AUTHENT1A                  0x60
 #define PICC_AUTHENT1B                  0x61
 #define PICC_READ                       0x30
@@ -84,18 +88,158 @@
 #define MI_OK                           0
 #define MI_NOTAGERR                     1
 #define MI_ERR                          2
+#define MI_COLLERR                      3   // 비트 충돌 (여러 카드 동시 응답)
+
+// 명령별 응답 대기 시간 (RC522 타이머 TimerIRq, 25us 단위)
+#define RC522_TMO_SHORT_US              1000    // REQA/ANTICOLL/SELECT/HALT (응답 ~90us)
+#define RC522_TMO_READ_US               5000
+#define RC522_TMO_AUTH_US               10000
+#define RC522_TMO_WRITE_US              10000
+
+// FIFO에서 읽는 최대 응답 길이 (FIFO 전체, NTAG FAST_READ 15페이지 + CRC_A), backData 버퍼 크기
+#define MFRC522_MAX_LEN                 64
+
+// 카드 종류 (ATQA/SAK 기준, NXP AN10833)
+#define RC522_TYPE_UNKNOWN              0
+#define RC522_TYPE_CLASSIC_1K           1   // SAK 0x08 (Mini 0x09, SmartMX 에뮬레이션 0x28 포함)
+#define RC522_TYPE_CLASSIC_4K           2   // SAK 0x18 (0x38)
+#define RC522_TYPE_ULTRALIGHT           3   // SAK 0x00: Ultralight, NTAG21x
+#define RC522_TYPE_DESFIRE              4   // SAK 0x20 + ATQA 0x0344
+#define RC522_TYPE_ISO_DEP              5   // SAK 0x20 기타: 은행 카드, 휴대폰 카드 에뮬레이션
+#define RC522_TYPE_PROPRIETARY          6   // ATQA에 비트 안티콜리전 없음 (Topaz 등), REQA 직후 판별
+#define RC522_TYPE_RANDOM_UID           7   // UID0 = 0x08: 매번 바뀌는 UID (휴대폰), CL1 직후 판별
+#define RC522_NUM_TYPES                 8
+
+#define RC522_TYPE_MASK(t)              (1U << (t))
+#define RC522_IS_CLASSIC(t)             ((t) == RC522_TYPE_CLASSIC_1K || (t) == RC522_TYPE_CLASSIC_4K)
+// 기본 허용: UID가 고정된 카드만 (출석 기록 가능)
+#define RC522_ACCEPT_DEFAULT            (RC522_TYPE_MASK(RC522_TYPE_CLASSIC_1K) | \
+                                         RC522_TYPE_MASK(RC522_TYPE_CLASSIC_4K) | \
+                                         RC522_TYPE_MASK(RC522_TYPE_ULTRALIGHT) | \
+                                         RC522_TYPE_MASK(RC522_TYPE_DESFIRE))
+
+// 카드 UID (4/7/10 바이트)
+typedef struct {
+    uint8_t size;       // UID 길이 (4, 7, 10)
+    uint8_t uid[10];
+    uint8_t sak;        // 마지막 캐스케이드 레벨의 SAK
+    uint8_t atqa[2];    // REQA 응답 (LSB 먼저)
+    uint8_t type;       // RC522_TYPE_xxx
+} RC522_UidTypeDef;
+
+// 카드에 저장하는 학생 레코드 (MIFARE Classic, 섹터 1 블록 4~5)
+#define RC522_RECORD_SECTOR             1
+
+typedef struct {
+    uint32_t student_id;
+    uint32_t courses;   // 수강 과목 비트맵 (bit n = 과목 n)
+    char name[10];
+} RC522_RecordTypeDef;
 
 // 함수 원형
 void MFRC522_Init(void);
-uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType);
+uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType);     // TagType 2바이트 (ATQA)
 uint8_t MFRC522_Anticoll(uint8_t *SerNum);
-uint8_t MFRC522_SelectTag(uint8_t *SerNum);
+uint8_t MFRC522_AnticollLevel(uint8_t selCmd, uint8_t *SerNum);  // SerNum 5바이트 (UID 4 + BCC)
+uint8_t MFRC522_SelectTag(uint8_t selCmd, uint8_t *SerNum, uint8_t *sak);
+void RC522_CrcA(const uint8_t *data, uint8_t len, uint8_t *result);    // 소프트웨어 CRC_A (테이블), 송수신 프레임 공통
 uint8_t MFRC522_Auth(uint8_t authMode, uint8_t BlockAddr, uint8_t *Sectorkey, uint8_t *SerNum);
 uint8_t MFRC522_Read(uint8_t blockAddr, uint8_t *recvData);
 uint8_t MFRC522_Write(uint8_t blockAddr, uint8_t *writeData);
 void MFRC522_Halt(void);
+void MFRC522_AntennaOn(void);
+void MFRC522_AntennaOff(void);
+void MFRC522_StopCrypto1(void);
+uint8_t MFRC522_ReadSector(uint8_t sector, uint8_t authMode, uint8_t *key, uint8_t *SerNum, uint8_t *data);
+uint8_t MFRC522_TransceiveCrc(uint8_t *frame, uint8_t len, uint8_t *back, uint8_t backLen);  // CRC_A 송수신 포함
+
+// 학생 레코드 (RC522_EVT_UID 직후, 카드가 선택된 상태에서 호출)
+uint8_t RC522_ReadRecord(RC522_UidTypeDef *uid, uint8_t *key, RC522_RecordTypeDef *rec);
+uint8_t RC522_WriteRecord(RC522_UidTypeDef *uid, uint8_t *key, RC522_RecordTypeDef *rec);
+uint8_t RC522_ParseRecord(const uint8_t *data, RC522_RecordTypeDef *rec);  // 레코드 이미지 32바이트 해석
+
+// FIFO 버스트 접근 (CS 한 번에 N 바이트)
+void MFRC522_WriteFIFO(const uint8_t *data, uint8_t len);
+void MFRC522_ReadFIFO(uint8_t *data, uint8_t len);
+
+// 비동기 명령 (StartCommand -> CommandDone 폴링 -> FinishCommand)
+void MFRC522_StartCommand(uint8_t command, uint8_t *sendData, uint8_t sendLen);
+void MFRC522_SetTimeout(uint16_t us);   // 다음 명령 1회만 적용
+uint8_t MFRC522_CommandDone(void);
+uint8_t MFRC522_FinishCommand(uint8_t *backData, uint8_t backMax, uint16_t *backLen);  // backMax 바이트까지만 복사
+
+// RC522_Task 이벤트
+#define RC522_EVT_NONE                  0
+#define RC522_EVT_CARD                  1   // 카드 감지 (ATQA 수신)
+#define RC522_EVT_UID                   2   // UID 준비됨 (RC522_GetUid, SELECT 완료)
+#define RC522_EVT_ERROR                 3   // 충돌/BCC/CRC 오류
+#define RC522_EVT_REJECT                4   // 허용하지 않는 카드 종류 (RC522_GetUid: type, 읽은 만큼의 UID)
+
+// 논블로킹 상태 머신 (현재 리더, 메인 루프에서 매번 호출)
+uint8_t RC522_Task(void);
+uint8_t RC522_Busy(void);
+void RC522_GetUid(RC522_UidTypeDef *uid);
+
+// 카드 종류 판별 및 필터 (모든 리더 공통)
+uint8_t RC522_CardType(uint8_t sak, const uint8_t *atqa);
+const char *RC522_TypeName(uint8_t type);
+void RC522_SetAccept(uint16_t mask);    // RC522_TYPE_MASK 조합
+uint16_t RC522_GetAccept(void);
+
+// 편의 함수 (블로킹, 한 사이클 완료까지 대기)
+uint8_t RC522_Check(RC522_UidTypeDef *uid);
+uint8_t RC522_Inventory(RC522_UidTypeDef *list, uint8_t max);   // 필드 내 모든 카드 (블로킹)
+
+// SPI 트랜잭션 수 (CS 구간 단위, 부팅 후 누적)
+uint32_t RC522_GetSpiCount(void);
+
+// 상태 감시 (메인 루프에서 호출, 몇 초에 레지스터 1회 읽기)
+#define RC522_HEALTH_MS                 3000
+#define RC522_HEALTH_WINDOW             64      // 오류율 계산 단위 (명령 수)
+#define RC522_HEALTH_MAX_ERR            16      // 이 이상 오류 시 재초기화
+
+typedef struct {
+    uint32_t transactions;  // SPI 트랜잭션
+    uint32_t commands;      // 카드 명령
+    uint32_t timeouts;      // 응답 없음 (카드 없음, 정상)
+    uint32_t collisions;    // 비트 충돌 (여러 카드, 정상)
+    uint32_t lost_irqs;     // IRQ 미발생 (소프트웨어 타임아웃)
+    uint32_t frame_errors;  // 패리티/프로토콜/버퍼 오류
+    uint32_t crc_errors;    // 응답 CRC_A 불일치
+    uint32_t health_fails;  // VersionReg/TxControlReg 검사 실패
+    uint32_t reinits;       // 재초기화 횟수
+    uint32_t rejects;       // 허용하지 않는 카드 종류 (RC522_EVT_REJECT)
+} RC522_StatsTypeDef;
+
+uint8_t RC522_Health(void);     // 재초기화한 리더 수
+void RC522_GetStats(uint8_t reader, RC522_StatsTypeDef *st);
+uint8_t MFRC522_ReadRegisterRaw(uint8_t addr);  // 섀도 캐시 무시
+
+// 다중 리더 (SPI1 공유, 리더별 CS/IRQ; 핀은 rc522.c 참고)
+// MFRC522_* / RC522_* 함수는 모두 현재 리더(RC522_UseReader)에 동작
+#ifndef RC522_NUM_READERS
+#define RC522_NUM_READERS               2       // 없는 리더는 초기화 시 제외됨
+#endif
+
+// 스캔 결과 (모든 리더의 UID를 발생 순서대로 하나의 스트림으로)
+typedef struct {
+    uint8_t reader;         // 리더 번호 (0..RC522_NUM_READERS-1)
+    uint32_t seq;           // UID 일련번호 (리더 무관, 1부터)
+    uint32_t time_ms;       // 검출 시각 (sys_tick_ms)
+    RC522_UidTypeDef uid;
+} RC522_ScanTypeDef;
+
+void RC522_InitReaders(void);
+void RC522_UseReader(uint8_t n);
+uint8_t RC522_CurrentReader(void);
+uint8_t RC522_ReaderPresent(uint8_t n);
+void RC522_AntennaAll(uint8_t on);
 
-// 편의 함수 (이걸 메인에서 쓰세요)
-uint8_t RC522_Check(uint8_t *id);
+// 라운드 로빈 스케줄러: StartCycle로 모든 리더에 REQA 요청, Scan을 반복 호출
+// Scan은 이벤트를 낸 리더를 현재 리더로 두고 반환 (선택된 카드를 바로 읽을 수 있음)
+void RC522_StartCycle(void);
+uint8_t RC522_Scan(RC522_ScanTypeDef *scan);    // RC522_EVT_xxx, UID일 때만 scan 전체 유효 (REJECT: reader, uid)
+uint8_t RC522_ScanBusy(void);
+uint8_t RC522_ScanReady(void);
 
 #endif
\ No newline at end of file
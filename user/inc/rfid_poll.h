@@ -0,0 +1,41 @@
+/* Core/Inc/rfid_poll.h */
+#ifndef __RFID_POLL_H
+#define __RFID_POLL_H
+
+#include "main.h"
+
+// 폴링 모드
+#define POLL_OFF            0   // 출석 시간 외: 안테나 OFF, 주기적으로 잠깐 켜서 확인
+#define POLL_SLOW           1   // 지각 구간 등 한산한 시간
+#define POLL_FAST           2   // 출석 시작 직후 (문 앞 대기열)
+
+// 주기 (ms)
+#define POLL_FAST_MS        20
+#define POLL_SLOW_MS        150
+#define POLL_WAKE_MS        1000    // OFF 모드 확인 주기
+#define POLL_SETTLE_MS      5       // 안테나 ON 후 카드 전원 안정화
+
+#define POLL_FAST_WINDOW_S  300     // 출석 시작 후 FAST 유지 시간 (초)
+
+// 모드별 통계
+typedef struct {
+    uint32_t cycles;        // REQA 사이클 수
+    uint32_t detects;       // UID 검출 수
+    uint32_t ttd_count;     // time-to-detect 측정 수
+    uint32_t ttd_sum_ms;    // 마지막 빈 필드 폴링 ~ UID 검출
+    uint32_t ttd_max_ms;
+    uint32_t time_ms;       // 이 모드에 머문 시간
+} Poll_StatsTypeDef;
+
+// 함수 원형
+void Poll_Init(void);
+uint8_t Poll_ModeFor(uint32_t now_s, uint32_t att_s, uint32_t late_s, uint8_t active);
+void Poll_SetMode(uint8_t mode);
+uint8_t Poll_GetMode(void);
+uint8_t Poll_Due(void);
+void Poll_Event(uint8_t evt);
+uint32_t Poll_NextDelay(uint32_t max_ms);
+void Poll_GetStats(uint8_t mode, Poll_StatsTypeDef *st);
+void Poll_ResetStats(void);
+
+#endif
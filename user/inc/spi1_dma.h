@@ -0,0 +1,48 @@
+/* Core/Inc/spi1_dma.h */
+#ifndef __SPI1_DMA_H
+#define __SPI1_DMA_H
+
+#include "main.h"
+
+// 전송 상태
+#define SPI1_XFER_IDLE      0   // 아직 제출 안 됨
+#define SPI1_XFER_QUEUED    1
+#define SPI1_XFER_ACTIVE    2
+#define SPI1_XFER_DONE      3
+
+// 전송 플래그
+#define SPI1_KEEP_CS        0x01    // 완료 후 CS 유지 (다음 전송과 한 CS 구간으로 연결)
+
+// 이 길이 미만은 DMA 대신 폴링 (DMA 설정 + 인터럽트 비용이 더 큼)
+#define SPI1_DMA_MIN        4
+
+// 전송 디스크립터 (호출자 소유, 완료 전까지 유효해야 함)
+typedef struct SPI1_Xfer {
+    const uint8_t *tx;              // NULL: 0x00 송신
+    uint8_t *rx;                    // NULL: 수신 데이터 버림
+    uint16_t len;
+    GPIO_TypeDef *cs_port;          // NULL: CS 제어 안 함
+    uint16_t cs_pin;
+    uint8_t flags;                  // SPI1_KEEP_CS
+    void (*done)(struct SPI1_Xfer *x);  // 완료 콜백 (DMA 인터럽트 문맥), NULL 가능
+    void *ctx;                      // 콜백용 사용자 데이터
+    volatile uint8_t status;        // SPI1_XFER_xxx
+    struct SPI1_Xfer *next;         // 큐 내부용
+} SPI1_XferTypeDef;
+
+// 하위 전송 계층 (실제 SPI1+DMA 또는 호스트용 가짜 SPI)
+typedef struct {
+    void (*select)(GPIO_TypeDef *port, uint16_t pin, uint8_t active);
+    void (*start)(const uint8_t *tx, uint8_t *rx, uint16_t len);   // 끝나면 SPI1_Complete() 호출
+} SPI1_BackendTypeDef;
+
+// 함수 원형
+void SPI1_DMA_Init(void);
+void SPI1_SetBackend(const SPI1_BackendTypeDef *backend);
+void SPI1_Submit(SPI1_XferTypeDef *x);
+void SPI1_Wait(SPI1_XferTypeDef *x);
+void SPI1_Transfer(SPI1_XferTypeDef *x);
+uint8_t SPI1_Idle(void);
+void SPI1_Complete(void);
+
+#endif
@@ -0,0 +1,18 @@
+/* Core/Inc/uid_cache.h */
+#ifndef __UID_CACHE_H
+#define __UID_CACHE_H
+
+#include "main.h"
+#include "rc522.h"
+
+// 최근 처리한 UID 캐시 (중복 태그 억제)
+#define UID_CACHE_SIZE          16          // 슬롯 수 (2의 거듭제곱)
+#define UID_CACHE_WINDOW_MS     30000       // 기본 억제 시간
+
+// 함수 원형
+void UidCache_Clear(void);
+void UidCache_SetWindow(uint32_t ms);
+uint8_t UidCache_Recent(const RC522_UidTypeDef *uid, uint32_t now);
+void UidCache_Add(const RC522_UidTypeDef *uid, uint32_t now);
+
+#endif
@@ -0,0 +1,78 @@
+/* Core/Src/latency.c */
+#include "latency.h"
+
+// Timestamps come from the DWT cycle counter (wraps after ~59 s at 72 MHz,
+// far longer than any stage). Durations go into log2 buckets of microseconds,
+// so a percentile is known to within a factor of two; the maximum is exact.
+
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+
+static Latency_StatsTypeDef lat_stats[LAT_NUM_STAGES];
+static uint32_t lat_cycles_per_us = 72;
+
+static const char *const lat_names[LAT_NUM_STAGES] = {
+    "read", "lookup", "lcd", "beep", "uart", "total"
+};
+
+void Latency_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT_CTRL |= 1;  // CYCCNTENA
+    lat_cycles_per_us = SystemCoreClock / 1000000;
+    Latency_Reset();
+}
+
+uint32_t Latency_Now(void) {
+    return DWT_CYCCNT;
+}
+
+void Latency_Add(uint8_t stage, uint32_t start, uint32_t end) {
+    Latency_StatsTypeDef *st;
+    uint32_t us;
+    uint8_t k = 0;
+
+    if (stage >= LAT_NUM_STAGES) return;
+    st = &lat_stats[stage];
+    us = (end - start) / lat_cycles_per_us;
+    while (k < LAT_BUCKETS - 1 && (us >> (k + 1)) != 0) {
+        k++;
+    }
+    st->hist[k]++;
+    st->count++;
+    if (us > st->max_us) st->max_us = us;
+}
+
+void Latency_GetStats(uint8_t stage, Latency_StatsTypeDef *st) {
+    if (stage >= LAT_NUM_STAGES) return;
+    *st = lat_stats[stage];
+}
+
+// Upper edge of the bucket holding the pct-th percentile, capped to the maximum
+uint32_t Latency_Percentile(const Latency_StatsTypeDef *st, uint8_t pct) {
+    uint32_t rank;
+    uint32_t seen = 0;
+    uint32_t edge;
+    uint8_t k;
+
+    if (st->count == 0) return 0;
+    rank = ((uint64_t)st->count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    for (k = 0; k < LAT_BUCKETS - 1; k++) {
+        seen += st->hist[k];
+        if (seen >= rank) break;
+    }
+    edge = (k < LAT_BUCKETS - 1) ? (2UL << k) - 1 : st->max_us;
+    return (edge < st->max_us) ? edge : st->max_us;
+}
+
+const char *Latency_Name(uint8_t stage) {
+    return (stage < LAT_NUM_STAGES) ? lat_names[stage] : "?";
+}
+
+void Latency_Reset(void) {
+    uint8_t i;
+    Latency_StatsTypeDef zero = { 0 };
+    for (i = 0; i < LAT_NUM_STAGES; i++) {
+        lat_stats[i] = zero;
+    }
+}
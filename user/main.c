@@ -1,12 +1,20 @@
 #include "stm32f10x.h"
 #include "rc522.h"
+#include "ntag.h"
+#include "spi1_dma.h"
+#include "i2c1.h"
+#include "rfid_poll.h"
+#include "uid_cache.h"
 #include "ds3231.h"
 #include "lcd.h"
+#include "touch.h"
+#include "admin.h"
+#include "latency.h"
 #include <stdio.h>
 #include <string.h>
 
 /* --- Global Variables --- */
-volatile uint8_t rfid_irq_flag = 0;
+volatile uint8_t rfid_irq_flag = 0; /* [수정] RC522 IRQ (EXTI0/2): WFI 깨우기용, 완료 판단은 rc522.c가 핀 레벨로 */
 volatile uint8_t rtc_alarm_flag = 0;
 
 #define RX_BUFFER_SIZE 64
@@ -34,20 +42,31 @@ uint8_t system_active = 0;
 
 /* 원래 방식대로 복구 */
 __IO uint32_t TimingDelay = 0;
+volatile uint32_t sys_tick_ms = 0; /* [추가] 1ms 단위 경과 시간 (RC522 타임아웃 등) */
 
 RTC_TimeTypeDef sTime;
 char str_buff[64];
 
 /* --- Student DB --- */
+/* [수정] UID 길이 가변 (4/7/10 바이트, NTAG/DESFire 7바이트 카드 지원) */
 struct {
-    uint8_t uid[4];
+    uint8_t uid_len;
+    uint8_t uid[10];
     char name[10];
 } db[] = {
-    {{0x1C, 0x43, 0x6D, 0x06}, "LeeNY"},
-    {{0x9B, 0x81, 0x4D, 0x06}, "SeungWoo"},
-    {{0xC9, 0xD4, 0x6B, 0x06}, "Andrea"}
+    {4, {0x1C, 0x43, 0x6D, 0x06}, "LeeNY"},
+    {4, {0x9B, 0x81, 0x4D, 0x06}, "SeungWoo"},
+    {4, {0xC9, 0xD4, 0x6B, 0x06}, "Andrea"}
 };
 
+/* --- Card Record (MIFARE Classic) --- */
+/* [추가] DB에 없는 카드는 카드에 저장된 학생 레코드로 확인 */
+#define COURSE_BIT 0 /* 이 강의의 과목 번호 (레코드 courses 비트) */
+static uint8_t card_key[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}; /* 레코드 섹터 Key A (배포 시 교체) */
+#define NTAG_PWD 0 /* [추가] NTAG 레코드 PWD_AUTH 비밀번호 (uint8_t[4]), 0: 인증 없음 */
+static uint8_t enroll_pending = 0; /* ENROLL 명령 후 다음 카드에 레코드 기록 */
+static RC522_RecordTypeDef enroll_rec;
+
 /* --- Function Prototypes --- */
 void RCC_Configuration(void);
 void GPIO_Configuration(void);
@@ -57,12 +76,16 @@ void I2C_Configuration(void);
 void SPI_Configuration(void);
 void Delay(__IO uint32_t nTime);
 void Beep(int count);
+void Beep_Short(void);
 void Display_Idle_Screen(void);
 void Send_UART_Msg(USART_TypeDef* USARTx, char* msg);
 void I2C_ResetBus(void);
+void Idle_Wait(uint32_t ms);
+static void Enroll_Card(RC522_UidTypeDef *uid);
 
 /* --- SysTick Handler (원래 코드로 복구) --- */
 void SysTick_Handler(void) {
+    sys_tick_ms++;
     if (TimingDelay != 0x00) {
         TimingDelay--;
     }
@@ -73,15 +96,33 @@ int main(void)
 {
     /* [중요] 변수 선언을 무조건 맨 위로 올려서 에러 방지 */
     static uint8_t prev_sec = 0xFF; 
-    uint8_t uid[5];
+    static uint8_t result_hold = 0;     /* [추가] 결과 화면 유지 중 */
+    static uint32_t result_start = 0;
+    static uint8_t alarm_pending = 0;   /* [추가] 알람 처리 대기 (알람 이후 시계 읽기 결과 필요) */
+    static uint8_t alarm_reads = 0;
+    static uint32_t alarm_start = 0;
+    static uint32_t lat_card[RC522_NUM_READERS]; /* [추가] 리더별 REQA 응답 시각 (DWT) */
+    RC522_UidTypeDef uid;
+    RC522_ScanTypeDef scan;
+    RC522_RecordTypeDef card_rec;
+    char *user_name;
+    uint8_t rfid_evt;
+    Poll_StatsTypeDef poll_st;
+    RC522_StatsTypeDef rfid_st;
+    Latency_StatsTypeDef lat_st;
+    uint32_t lat_t0, lat_t1;
+    int beep_count;
     int user_idx;
     int db_count;
     int i;
     char status[10];
     char uart_buff[80];
-    char uid_str[16];
+    char uid_str[24];
     char time_str[20];
     char time_disp[20];
+    uint8_t cap_buf[TOUCH_CAP_FRAME_MAX]; /* [수정] 캡처 프레임(틱 단위, 가변 길이) */
+    uint32_t cap_frames, cap_dropped; /* [추가] 캡처 통계 */
+    uint16_t cap_len;
 
     SystemInit();
 
@@ -100,7 +141,10 @@ int main(void)
     NVIC_Configuration();
     USART_Configuration();
     I2C_Configuration(); 
+    I2C1_Init(); /* [추가] I2C1 인터럽트 트랜잭션 엔진 (DS3231) */
     SPI_Configuration(); 
+    SPI1_DMA_Init(); /* [추가] SPI1 DMA 전송 엔진 (RC522) */
+    Latency_Init(); /* [추가] 출석 처리 단계별 지연 측정 (DWT) */
 
     /* [진단] LCD 초기화 전 비프음: CPU 정상 동작 확인 및 전원 안정화 대기 */
     /* 소리가 나면 CPU는 정상입니다. 소리가 나는데 화면이 안 나오면 LCD 배선을 확인하세요. */
@@ -110,7 +154,11 @@ int main(void)
     DS3231_ResetI2CError();
 
     LCD_Init();
-    MFRC522_Init();
+    Touch_Init(0); /* [추가] 백업 레지스터의 터치 보정값 복원 (CRC 오류 시에만 보정 실행) */
+    Touch_Sampler_Start(); /* [추가] TIM3 터치 샘플링 시작 (관리자 메뉴용) */
+    Admin_Init();
+    RC522_InitReaders(); /* [수정] 리더 전체 초기화 (연결 안 된 리더는 제외) */
+    Poll_Init(); /* [추가] 출석 시간 외에는 안테나 OFF (주기적 wake 검사) */
     DS3231_Init(&sTime);
     DS3231_SetTime(&sTime); /* [수정] 구조체에 설정된 시간을 실제 DS3231 모듈에 전송 */
     
@@ -127,12 +175,23 @@ int main(void)
 
     while (1)
     {
-        DS3231_GetTime(&sTime);
+        /* [수정] 시계 갱신은 I2C 인터럽트 전송 결과만 반영 (루프가 I2C를 기다리지 않음) */
+        if (DS3231_PollTime(&sTime) && alarm_reads) {
+            alarm_reads--;
+        }
         
         if (sTime.seconds != prev_sec) {
             prev_sec = sTime.seconds;
-            sprintf(time_str, "%02d:%02d:%02d", sTime.hours, sTime.minutes, sTime.seconds);
-            LCD_ShowString(30, 130, (uint8_t*)time_str, BLACK, WHITE);
+            if (!Admin_IsOpen() && !result_hold) { /* [추가] 관리자 메뉴/결과 화면 위에 그리지 않음 */
+                sprintf(time_str, "%02d:%02d:%02d", sTime.hours, sTime.minutes, sTime.seconds);
+                LCD_ShowString(30, 130, (uint8_t*)time_str, BLACK, WHITE);
+            }
+
+            /* [추가] 시간대별 RFID 폴링 모드 (출석 직후 FAST, 이후 SLOW, 시간 외 OFF) */
+            Poll_SetMode(Poll_ModeFor(sTime.hours * 3600UL + sTime.minutes * 60UL + sTime.seconds,
+                                      att_hour * 3600UL + att_min * 60UL + att_sec,
+                                      late_hour * 3600UL + late_min * 60UL + late_sec,
+                                      system_active));
 
             /* [수정] 시간 기반 이벤트 체크 (초 단위 정밀 제어) - 중복 실행 방지를 위해 초 변경 시 수행 */
             if (system_active) {
@@ -157,7 +216,13 @@ int main(void)
         if (rtc_alarm_flag) {
             rtc_alarm_flag = 0;
             DS3231_ClearAlarmFlags();
-            DS3231_GetTime(&sTime);
+            /* [수정] 블로킹 GetTime 대신 캐시된 sTime 사용: 이 시점 이후 요청된 읽기 결과(2회째)를 기다림 */
+            alarm_pending = 1;
+            alarm_reads = 2;
+            alarm_start = sys_tick_ms;
+        }
+        if (alarm_pending && (!alarm_reads || (sys_tick_ms - alarm_start) >= 100)) { /* 100ms: I2C 오류 시 기존 값으로 처리 */
+            alarm_pending = 0;
 
             if (sTime.hours == att_hour && sTime.minutes == att_min) {
                 if(!system_active) {
@@ -171,25 +236,81 @@ int main(void)
         }
 
         // B. RFID Handling
-        if (system_active) {
-            if (RC522_Check(uid) == MI_OK) {
+        /* [수정] 결과 화면 1초 유지 (Delay 대신 시간 비교, 루프는 계속 동작) */
+        if (result_hold && (sys_tick_ms - result_start) >= 1000) {
+            result_hold = 0;
+            GPIO_SetBits(GPIOB, GPIO_Pin_0 | GPIO_Pin_1); /* [수정] LED OFF */
+            Display_Idle_Screen();
+        }
+
+        /* [추가] RC522 상태 감시: 칩 리셋/SPI 이상 시 재초기화 */
+        if (RC522_Health() > 0) {
+            Send_UART_Msg(ACTIVE_USART, "[RFID REINIT]\r\n");
+        }
+
+        /* [수정] 모든 리더의 상태 머신을 라운드 로빈으로 한 단계씩 진행 (블로킹 없음) */
+        /* [수정] 새 사이클 시작 시점은 폴링 스케줄러가 결정 (모드별 주기) */
+        /* [수정] 결과 화면 중에도 모든 리더 스캔 계속 (새 결과가 화면을 갱신하고 1초 유지 재시작) */
+        if (!Admin_IsOpen()) {
+            if (Poll_Due()) {
+                RC522_StartCycle();
+            }
+            rfid_evt = RC522_Scan(&scan); /* UID 이벤트면 해당 리더가 현재 리더 (카드 선택 상태) */
+            Poll_Event(rfid_evt);
+            if (rfid_evt == RC522_EVT_CARD) {
+                lat_card[scan.reader] = Latency_Now();
+            }
+            if (rfid_evt == RC522_EVT_UID) {
+                uid = scan.uid;
+                lat_t0 = Latency_Now(); /* [추가] 단계별 지연: read -> lookup -> lcd -> beep -> uart */
+                Latency_Add(LAT_READ, lat_card[scan.reader], lat_t0);
+            }
+            if (rfid_evt == RC522_EVT_UID && !system_active) {
+                /* [추가] 출석 시간 외 (wake 검사): 카드 등록만 처리 */
+                Enroll_Card(&uid);
+            } else if (rfid_evt == RC522_EVT_UID && !enroll_pending && UidCache_Recent(&uid, sys_tick_ms)) {
+                /* [추가] 최근 출석 처리된 카드 재태그: 짧은 비프만 (화면/기록 없음) */
+                Beep_Short();
+            } else if (rfid_evt == RC522_EVT_UID) {
+                Enroll_Card(&uid); /* [추가] 등록 대기 중이면 레코드 기록 후 일반 처리 */
+                
                 user_idx = -1;
                 db_count = sizeof(db) / sizeof(db[0]);
                 
                 // [수정] 변수 i는 맨 위에서 선언했음
                 for (i = 0; i < db_count; i++) {
-                    if (memcmp(db[i].uid, uid, 4) == 0) {
+                    if (db[i].uid_len == uid.size && memcmp(db[i].uid, uid.uid, uid.size) == 0) {
                         user_idx = i; break;
                     }
                 }
                 
-                DS3231_GetTime(&sTime);
-                sprintf(uid_str, "%02X%02X%02X%02X", uid[0], uid[1], uid[2], uid[3]);
+                /* [추가] DB에 없으면 카드 레코드 확인 (MIFARE Classic, 이 과목 수강자만) */
+                user_name = 0;
+                if (user_idx != -1) {
+                    user_name = db[user_idx].name;
+                } else if (RC522_IS_CLASSIC(uid.type) && /* [수정] 카드 종류별: Classic만 섹터 레코드 */
+                           RC522_ReadRecord(&uid, card_key, &card_rec) == MI_OK &&
+                           (card_rec.courses & (1UL << COURSE_BIT))) {
+                    user_name = card_rec.name;
+                } else if (uid.type == RC522_TYPE_ULTRALIGHT && /* [추가] NTAG 스티커: FAST_READ 한 번 */
+                           NTAG_ReadRecord(NTAG_PWD, &card_rec) == MI_OK &&
+                           (card_rec.courses & (1UL << COURSE_BIT))) {
+                    user_name = card_rec.name;
+                }
+                
+                /* [수정] 시각은 루프마다 갱신되는 sTime 사용 (I2C 대기 없음) */
+                for (i = 0; i < uid.size; i++) {
+                    sprintf(&uid_str[i * 2], "%02X", uid.uid[i]);
+                }
+                lat_t1 = Latency_Now();
+                Latency_Add(LAT_LOOKUP, lat_t0, lat_t1);
 
+                GPIO_SetBits(GPIOB, GPIO_Pin_0 | GPIO_Pin_1); /* [추가] 이전 결과의 LED 끄기 */
                 LCD_Clear(WHITE);
                 
-                if (user_idx != -1) {
-                    LCD_ShowString(20, 20, (uint8_t*)db[user_idx].name, BLACK, WHITE);
+                if (user_name) {
+                    UidCache_Add(&uid, sys_tick_ms); /* [추가] 중복 태그 억제 */
+                    LCD_ShowString(20, 20, (uint8_t*)user_name, BLACK, WHITE);
                     sprintf(time_disp, "%02d:%02d:%02d", sTime.hours, sTime.minutes, sTime.seconds);
                     LCD_ShowString(20, 50, (uint8_t*)time_disp, BLACK, WHITE);
 
@@ -200,28 +321,36 @@ int main(void)
                         strcpy(status, "LATE");
                         LCD_ShowString(20, 80, (uint8_t*)"Status: LATE", RED, WHITE);
                         GPIO_ResetBits(GPIOB, GPIO_Pin_0); /* [수정] LED ON (Active Low) */
-                        Beep(2);
+                        beep_count = 2;
                     } else {
                         strcpy(status, "OK");
                         LCD_ShowString(20, 80, (uint8_t*)"Status: OK", GREEN, WHITE);
                         GPIO_ResetBits(GPIOB, GPIO_Pin_1); /* [수정] LED ON (Active Low) */
-                        Beep(1);
+                        beep_count = 1;
                     }
-                    sprintf(uart_buff, "%s,%s,%02d:%02d,%s\r\n", db[user_idx].name, uid_str, sTime.hours, sTime.minutes, status);
+                    sprintf(uart_buff, "%s,%s,%02d:%02d,%s\r\n", user_name, uid_str, sTime.hours, sTime.minutes, status);
                 } else {
                     LCD_ShowString(20, 20, (uint8_t*)"UNKNOWN TAG", RED, WHITE);
                     LCD_ShowString(20, 50, (uint8_t*)uid_str, BLACK, WHITE);
                     GPIO_ResetBits(GPIOB, GPIO_Pin_0 | GPIO_Pin_1); /* [수정] LED ON (Active Low) */
-                    Beep(3);
+                    beep_count = 3;
                     sprintf(uart_buff, "UNKNOWN,%s,%02d:%02d\r\n", uid_str, sTime.hours, sTime.minutes);
                 }
                 
+                lat_t0 = Latency_Now();
+                Latency_Add(LAT_LCD, lat_t1, lat_t0);
+                Beep(beep_count); /* [수정] 화면 표시 후 비프 (지연 측정 단계 분리) */
+                lat_t1 = Latency_Now();
+                Latency_Add(LAT_BEEP, lat_t0, lat_t1);
+                
                 // [요청사항] UART2로만 전송
                 Send_UART_Msg(ACTIVE_USART, uart_buff);
+                lat_t0 = Latency_Now();
+                Latency_Add(LAT_UART, lat_t1, lat_t0);
+                Latency_Add(LAT_TOTAL, lat_card[scan.reader], lat_t0);
                 
-                Delay(1000); /* [수정] 1초 유지 */
-                GPIO_SetBits(GPIOB, GPIO_Pin_0 | GPIO_Pin_1); /* [수정] LED OFF */
-                Display_Idle_Screen();
+                result_hold = 1;
+                result_start = sys_tick_ms;
             }
         }
 
@@ -263,6 +392,93 @@ int main(void)
 
                         Send_UART_Msg(ACTIVE_USART, "RESET OK\r\n");
                         Display_Idle_Screen(); /* [추가] 리셋 후 화면 갱신 */
+                    } else if (strcmp(cmd_buffer, "CALIBRATE") == 0) { /* [추가] 터치 재보정 명령 */
+                        Touch_Sampler_Stop();
+                        Touch_Init(1);
+                        Touch_Sampler_Start();
+                        Send_UART_Msg(ACTIVE_USART, "Touch Calibrated\r\n");
+                        Display_Idle_Screen();
+                    } else if (strcmp(cmd_buffer, "TOUCH BENCH") == 0) { /* [추가] 터치 ADC 변환 속도 측정 (DWT) */
+                        Touch_Sampler_Stop();
+                        sprintf(uart_buff, "Touch bit-bang: %lu samples/s\r\n",
+                                (unsigned long)Touch_Benchmark(TOUCH_TRANSPORT_BITBANG, 1000));
+                        Send_UART_Msg(ACTIVE_USART, uart_buff);
+                        sprintf(uart_buff, "Touch SPI3 DMA: %lu samples/s\r\n",
+                                (unsigned long)Touch_Benchmark(TOUCH_TRANSPORT_SPI3, 1000));
+                        Send_UART_Msg(ACTIVE_USART, uart_buff);
+                        Touch_Sampler_Start();
+                    } else if (strcmp(cmd_buffer, "CAPTURE ON") == 0) { /* [추가] 터치 ADC 원시값 바이너리 스트림 */
+                        Touch_Capture_Start();
+                    } else if (strcmp(cmd_buffer, "CAPTURE OFF") == 0) {
+                        Touch_Capture_Stop();
+                        Touch_Capture_Stats(&cap_frames, &cap_dropped); /* [추가] 링 버퍼가 가득 차 버린 틱 수 보고 */
+                        sprintf(uart_buff, "\r\nCapture Off: %lu ticks, %lu dropped\r\n",
+                                (unsigned long)cap_frames, (unsigned long)cap_dropped);
+                        Send_UART_Msg(ACTIVE_USART, uart_buff);
+                    } else if (strncmp(cmd_buffer, "SET REPEAT ", 11) == 0) { /* [추가] 중복 태그 억제 시간 (초) */
+                        int sec;
+                        if (sscanf(cmd_buffer + 11, "%d", &sec) == 1 && sec >= 0) {
+                            UidCache_SetWindow(sec * 1000UL);
+                            Send_UART_Msg(ACTIVE_USART, "Repeat Window Set\r\n");
+                        }
+                    } else if (strcmp(cmd_buffer, "POLL STATS") == 0) { /* [추가] 폴링 모드별 검출 시간 통계 */
+                        for (i = POLL_FAST; i >= POLL_OFF; i--) {
+                            Poll_GetStats(i, &poll_st);
+                            sprintf(uart_buff, "%s cyc=%lu det=%lu ttd avg=%lu max=%lu ms, %lu s\r\n",
+                                    (i == POLL_FAST) ? "FAST" : (i == POLL_SLOW) ? "SLOW" : "OFF ",
+                                    (unsigned long)poll_st.cycles, (unsigned long)poll_st.detects,
+                                    (unsigned long)(poll_st.ttd_count ? poll_st.ttd_sum_ms / poll_st.ttd_count : 0),
+                                    (unsigned long)poll_st.ttd_max_ms, (unsigned long)(poll_st.time_ms / 1000));
+                            Send_UART_Msg(ACTIVE_USART, uart_buff);
+                        }
+                    } else if (strcmp(cmd_buffer, "POLL RESET") == 0) {
+                        Poll_ResetStats();
+                        Send_UART_Msg(ACTIVE_USART, "Poll Stats Reset\r\n");
+                    } else if (strcmp(cmd_buffer, "RFID STATS") == 0) { /* [추가] 리더 오류 카운터 */
+                        for (i = 0; i < RC522_NUM_READERS; i++) { /* [수정] 리더별 */
+                            if (!RC522_ReaderPresent(i)) {
+                                sprintf(uart_buff, "R%d not present\r\n", i);
+                                Send_UART_Msg(ACTIVE_USART, uart_buff);
+                                continue;
+                            }
+                            RC522_GetStats(i, &rfid_st);
+                            sprintf(uart_buff, "R%d spi=%lu cmd=%lu tmo=%lu coll=%lu rej=%lu\r\n", i,
+                                    (unsigned long)rfid_st.transactions, (unsigned long)rfid_st.commands,
+                                    (unsigned long)rfid_st.timeouts, (unsigned long)rfid_st.collisions,
+                                    (unsigned long)rfid_st.rejects);
+                            Send_UART_Msg(ACTIVE_USART, uart_buff);
+                            sprintf(uart_buff, "R%d irq=%lu frame=%lu crc=%lu health=%lu reinit=%lu\r\n", i,
+                                    (unsigned long)rfid_st.lost_irqs, (unsigned long)rfid_st.frame_errors,
+                                    (unsigned long)rfid_st.crc_errors, (unsigned long)rfid_st.health_fails,
+                                    (unsigned long)rfid_st.reinits);
+                            Send_UART_Msg(ACTIVE_USART, uart_buff);
+                        }
+                    } else if (strncmp(cmd_buffer, "RFID ACCEPT ", 12) == 0) { /* [추가] 허용 카드 종류 (RC522_TYPE_MASK, hex) */
+                        unsigned int mask;
+                        if (sscanf(cmd_buffer + 12, "%x", &mask) == 1) {
+                            RC522_SetAccept(mask);
+                            Send_UART_Msg(ACTIVE_USART, "Card Types Set\r\n");
+                        }
+                    } else if (strcmp(cmd_buffer, "LATENCY") == 0) { /* [추가] 단계별 지연 백분위 (us) */
+                        for (i = 0; i < LAT_NUM_STAGES; i++) {
+                            Latency_GetStats(i, &lat_st);
+                            sprintf(uart_buff, "%-6s n=%lu p50=%lu p90=%lu p99=%lu max=%lu us\r\n", Latency_Name(i),
+                                    (unsigned long)lat_st.count, (unsigned long)Latency_Percentile(&lat_st, 50),
+                                    (unsigned long)Latency_Percentile(&lat_st, 90), (unsigned long)Latency_Percentile(&lat_st, 99),
+                                    (unsigned long)lat_st.max_us);
+                            Send_UART_Msg(ACTIVE_USART, uart_buff);
+                        }
+                    } else if (strcmp(cmd_buffer, "LATENCY RESET") == 0) {
+                        Latency_Reset();
+                        Send_UART_Msg(ACTIVE_USART, "Latency Stats Reset\r\n");
+                    } else if (strncmp(cmd_buffer, "ENROLL ", 7) == 0) { /* [추가] ENROLL <학번> <과목비트(hex)> <이름> */
+                        unsigned long id, courses;
+                        if (sscanf(cmd_buffer + 7, "%lu %lx %9s", &id, &courses, enroll_rec.name) == 3) {
+                            enroll_rec.student_id = id;
+                            enroll_rec.courses = courses;
+                            enroll_pending = 1;
+                            Send_UART_Msg(ACTIVE_USART, "Tap Card To Enroll\r\n");
+                        }
                     } else if (strncmp(cmd_buffer, "SET ATTENDANCE ", 15) == 0) {
                         int h, m, s;
                         if (sscanf(cmd_buffer + 15, "%d:%d:%d", &h, &m, &s) == 3) {
@@ -295,7 +511,29 @@ int main(void)
                 if (cmd_len < 63) cmd_buffer[cmd_len++] = data;
             }
         }
-        Delay(50);
+
+        // D. Touch Admin Menu (long-press + 스와이프 코드로 진입, 블루투스 없이 시간 설정)
+        switch (Admin_Poll()) {
+            case ADMIN_SAVED:
+                Send_UART_Msg(ACTIVE_USART, "Admin Time Set\r\n");
+                Display_Idle_Screen();
+                break;
+            case ADMIN_CLOSED:
+                Display_Idle_Screen();
+                break;
+            default:
+                break;
+        }
+
+        // E. Touch Capture Stream (tools/touch_replay 로 재생, 프레임 단위라 텍스트 출력과 섞여도 재동기화 가능)
+        cap_len = Touch_Capture_Read(cap_buf, sizeof(cap_buf));
+        for (i = 0; i < cap_len; i++) {
+            while (USART_GetFlagStatus(ACTIVE_USART, USART_FLAG_TXE) == RESET);
+            USART_SendData(ACTIVE_USART, cap_buf[i]);
+        }
+
+        /* [수정] 메뉴가 열려 있으면 한 프레임(16ms) 이내로 반응하도록 짧게 대기 */
+        Idle_Wait(Admin_IsOpen() ? 5 : Poll_NextDelay(50)); /* [수정] 다음 폴링 시점까지만 대기 */
     }
 }
 
@@ -334,13 +572,20 @@ void Beep(int count) {
     }
 }
 
+/* [추가] 중복 태그 확인용 짧은 비프 */
+void Beep_Short(void) {
+    GPIO_ResetBits(GPIOA, GPIO_Pin_3); Delay(30);
+    GPIO_SetBits(GPIOA, GPIO_Pin_3);
+}
+
 void Display_Idle_Screen(void) {
     char time_str[20]; // [수정] 변수 선언 맨 위로
     char dbg_str[20];
     char conf_str[40]; // [추가] 설정 시간 표시용 버퍼
+    if (Admin_IsOpen()) return; /* [추가] 메뉴 종료 후 다시 그림 */
     LCD_Clear(WHITE);
     
-    DS3231_GetTime(&sTime);
+    /* [수정] sTime은 메인 루프의 DS3231_PollTime이 갱신 (I2C 대기 없음) */
 
     if(system_active) {
         /* [수정] Attendance vs Late 구분 표시 */
@@ -379,6 +624,26 @@ void Display_Idle_Screen(void) {
     LCD_ShowString(30, 230, (uint8_t*)conf_str, BLACK, WHITE);
 }
 
+/* [추가] 루프 대기: RC522 명령이 끝나면(IRQ) 바로 깨어나 다음 단계 진행 */
+void Idle_Wait(uint32_t ms) {
+    uint32_t start = sys_tick_ms;
+    while ((sys_tick_ms - start) < ms) {
+        if (RC522_ScanReady()) break; /* [수정] 어느 리더든 진행 가능하면 */
+        __WFI();
+    }
+}
+
+/* [추가] ENROLL 대기 중이면 선택된 카드에 학생 레코드 기록 (RC522_EVT_UID 직후 호출) */
+static void Enroll_Card(RC522_UidTypeDef *uid) {
+    if (!enroll_pending) return;
+    enroll_pending = 0;
+    if (RC522_IS_CLASSIC(uid->type) && RC522_WriteRecord(uid, card_key, &enroll_rec) == MI_OK) {
+        Send_UART_Msg(ACTIVE_USART, "Enroll OK\r\n");
+    } else {
+        Send_UART_Msg(ACTIVE_USART, "Enroll Failed\r\n");
+    }
+}
+
 void Delay(__IO uint32_t nTime) {
     TimingDelay = nTime;
     while (TimingDelay != 0);
@@ -423,9 +688,10 @@ void GPIO_Configuration(void) {
     GPIO_InitStructure.GPIO_Pin = GPIO_Pin_6;
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
     GPIO_Init(GPIOA, &GPIO_InitStructure);
-    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_4;
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_4 | GPIO_Pin_8; /* [수정] 리더 1, 2 CS */
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
     GPIO_Init(GPIOA, &GPIO_InitStructure);
+    GPIO_SetBits(GPIOA, GPIO_Pin_4 | GPIO_Pin_8); /* [추가] CS 비활성 (SPI1 공유) */
 
     // I2C1 (DS3231)
     GPIO_InitStructure.GPIO_Pin = GPIO_Pin_6 | GPIO_Pin_7;
@@ -445,8 +711,8 @@ void GPIO_Configuration(void) {
     GPIO_Init(GPIOB, &GPIO_InitStructure);
     GPIO_SetBits(GPIOB, GPIO_Pin_0 | GPIO_Pin_1); /* [수정] 초기 상태 OFF */
 
-    // IRQs
-    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 | GPIO_Pin_1;
+    // IRQs (PA0: 리더 1, PA1: RTC, PA2: 리더 2)
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_2;
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
     GPIO_Init(GPIOA, &GPIO_InitStructure);
 
@@ -522,6 +788,11 @@ void NVIC_Configuration(void) {
     EXTI_InitStructure.EXTI_Line = EXTI_Line1;
     EXTI_Init(&EXTI_InitStructure);
 
+    // [추가] 리더 2 IRQ (PA2) EXTI Line 2
+    GPIO_EXTILineConfig(GPIO_PortSourceGPIOA, GPIO_PinSource2);
+    EXTI_InitStructure.EXTI_Line = EXTI_Line2;
+    EXTI_Init(&EXTI_InitStructure);
+
     NVIC_InitStructure.NVIC_IRQChannel = EXTI0_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 2;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
@@ -530,6 +801,9 @@ void NVIC_Configuration(void) {
     // [수정] RTC Alarm 인터럽트(EXTI1) 활성화
     NVIC_InitStructure.NVIC_IRQChannel = EXTI1_IRQn;
     NVIC_Init(&NVIC_InitStructure);
+
+    NVIC_InitStructure.NVIC_IRQChannel = EXTI2_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
 }
 
 void USART1_IRQHandler(void) {
@@ -572,6 +846,13 @@ void EXTI0_IRQHandler(void) {
     }
 }
 
+/* [추가] 리더 2 IRQ: WFI 깨우기만 (완료 판단은 IRQ 핀 레벨) */
+void EXTI2_IRQHandler(void) {
+    if (EXTI_GetITStatus(EXTI_Line2) != RESET) {
+        rfid_irq_flag = 1; EXTI_ClearITPendingBit(EXTI_Line2);
+    }
+}
+
 void EXTI1_IRQHandler(void) {
     if (EXTI_GetITStatus(EXTI_Line1) != RESET) {
         rtc_alarm_flag = 1; EXTI_ClearITPendingBit(EXTI_Line1);
@@ -0,0 +1,119 @@
+/* Core/Src/ntag.c */
+#include "ntag.h"
+
+// Ultralight / NTAG21x commands on the current reader. They go through
+// MFRC522_TransceiveCrc, so the answer comes out of the FIFO in one burst read
+// and a whole FAST_READ (up to NTAG_FAST_READ_MAX pages) is a single exchange.
+
+// Answer air time per byte: 9 bits at 106 kbit/s
+#define NTAG_BYTE_US    86
+
+// Frame of len bytes (+ CRC_A) -> backLen bytes. Long answers need more than the
+// short timeout: the safety timeout has to cover the whole frame on air.
+static uint8_t NTAG_Exchange(uint8_t *buf, uint8_t len, uint8_t backLen) {
+    MFRC522_SetTimeout(RC522_TMO_SHORT_US + (backLen + 2) * NTAG_BYTE_US);
+    return MFRC522_TransceiveCrc(buf, len, buf, backLen);
+}
+
+uint8_t NTAG_GetVersion(NTAG_VersionTypeDef *ver) {
+    uint8_t buf[MFRC522_MAX_LEN];
+    uint8_t *out = (uint8_t *)ver;
+    uint8_t i;
+
+    buf[0] = NTAG_CMD_GET_VERSION;
+    if (NTAG_Exchange(buf, 1, 8) != MI_OK) {
+        return MI_ERR;      // Ultralight (non-EV1) NAKs, then needs a new REQA
+    }
+    for (i = 0; i < 8; i++) {
+        out[i] = buf[i];
+    }
+    return MI_OK;
+}
+
+// Bit 0 of the storage code set: between 2^n and 2^(n+1), the known sizes are listed
+uint16_t NTAG_UserBytes(const NTAG_VersionTypeDef *ver) {
+    switch (ver->storage) {
+        case 0x0B: return 48;       // Ultralight EV1 MF0UL11
+        case 0x0E: return 128;      // Ultralight EV1 MF0UL21
+        case 0x0F: return 144;      // NTAG213
+        case 0x11: return 504;      // NTAG215
+        case 0x13: return 888;      // NTAG216
+        default:
+            return (ver->storage & 0x01) ? 0 : (1U << (ver->storage >> 1));
+    }
+}
+
+// 4 pages from page (wraps at the end of memory)
+uint8_t NTAG_Read(uint8_t page, uint8_t *data) {
+    uint8_t buf[MFRC522_MAX_LEN];
+    uint8_t i;
+
+    buf[0] = NTAG_CMD_READ;
+    buf[1] = page;
+    if (NTAG_Exchange(buf, 2, 16) != MI_OK) {
+        return MI_ERR;
+    }
+    for (i = 0; i < 16; i++) {
+        data[i] = buf[i];
+    }
+    return MI_OK;
+}
+
+// Pages start..end, NTAG_FAST_READ_MAX pages per exchange
+uint8_t NTAG_FastRead(uint8_t start, uint8_t end, uint8_t *data) {
+    uint8_t buf[MFRC522_MAX_LEN];
+    uint8_t last;
+    uint8_t bytes;
+    uint8_t i;
+
+    if (end < start) {
+        return MI_ERR;
+    }
+    while (1) {
+        last = (end - start >= NTAG_FAST_READ_MAX) ? start + NTAG_FAST_READ_MAX - 1 : end;
+        bytes = (last - start + 1) * NTAG_PAGE_SIZE;
+        buf[0] = NTAG_CMD_FAST_READ;
+        buf[1] = start;
+        buf[2] = last;
+        if (NTAG_Exchange(buf, 3, bytes) != MI_OK) {
+            return MI_ERR;
+        }
+        for (i = 0; i < bytes; i++) {
+            *data++ = buf[i];
+        }
+        if (last == end) break;
+        start = last + 1;
+    }
+    return MI_OK;
+}
+
+uint8_t NTAG_PwdAuth(const uint8_t *pwd, uint8_t *pack) {
+    uint8_t buf[MFRC522_MAX_LEN];
+    uint8_t i;
+
+    buf[0] = NTAG_CMD_PWD_AUTH;
+    for (i = 0; i < 4; i++) {
+        buf[1 + i] = pwd[i];
+    }
+    if (NTAG_Exchange(buf, 5, 2) != MI_OK) {
+        return MI_ERR;      // Wrong password: NAK
+    }
+    if (pack) {
+        pack[0] = buf[0];
+        pack[1] = buf[1];
+    }
+    return MI_OK;
+}
+
+// The whole record area in one FAST_READ
+uint8_t NTAG_ReadRecord(const uint8_t *pwd, RC522_RecordTypeDef *rec) {
+    uint8_t data[NTAG_RECORD_PAGES * NTAG_PAGE_SIZE];
+
+    if (pwd && NTAG_PwdAuth(pwd, 0) != MI_OK) {
+        return MI_ERR;
+    }
+    if (NTAG_FastRead(NTAG_RECORD_PAGE, NTAG_RECORD_PAGE + NTAG_RECORD_PAGES - 1, data) != MI_OK) {
+        return MI_ERR;
+    }
+    return RC522_ParseRecord(data, rec);
+}
@@ -1,54 +1,238 @@
 /* Core/Src/rc522.c */
 #include "rc522.h"
+#include "spi1_dma.h"
 #include "stm32f10x.h"
 
 // External Delay function from main.c
 extern void Delay(__IO uint32_t nTime);
 
-// CS Pin Configuration
-#define RC522_CS_GPIO GPIOA
-#define RC522_CS_PIN  GPIO_Pin_4
+// Millisecond tick from main.c
+extern volatile uint32_t sys_tick_ms;
 
-// Macro Functions
-#define RC522_CS_LOW  GPIO_ResetBits(RC522_CS_GPIO, RC522_CS_PIN)
-#define RC522_CS_HIGH GPIO_SetBits(RC522_CS_GPIO, RC522_CS_PIN)
+// IRQ pin of the current reader (active low, stays low until ComIrqReg is cleared)
+#define RC522_IRQ_ACTIVE (GPIO_ReadInputDataBit(rdr->irq_port, rdr->irq_pin) == Bit_RESET)
 
-// SPI Interface (Assumed SPI1 from main.c)
-#define RC522_SPI SPI1
+// Safety net if the IRQ line never fires: command timeout + this margin
+#define RC522_IRQ_MARGIN_MS 3
 
-// Helper: SPI Transfer
-uint8_t SPI_ReadWriteByte(uint8_t data) {
-    // Wait until TX buffer is empty
-    while (SPI_I2S_GetFlagStatus(RC522_SPI, SPI_I2S_FLAG_TXE) == RESET);
-    // Send byte
-    SPI_I2S_SendData(RC522_SPI, data);
-    // Wait until RX buffer is not empty
-    while (SPI_I2S_GetFlagStatus(RC522_SPI, SPI_I2S_FLAG_RXNE) == RESET);
-    // Return received byte
-    return SPI_I2S_ReceiveData(RC522_SPI);
+// RC522 timer: TPrescaler = 169 -> (2 * 169 + 1) / 13.56MHz = 25us per tick
+#define RC522_TICK_US 25
+
+#define RC522_FIFO_SIZE 64
+
+// Reader states (see RC522_Task)
+#define RC522_ST_IDLE       0
+#define RC522_ST_REQA       1
+#define RC522_ST_ANTICOLL   2
+#define RC522_ST_SELECT     3
+#define RC522_ST_SELECTED   4
+#define RC522_ST_HALT       5
+
+// One RC522 on SPI1: pins and all driver state. Every MFRC522_* / RC522_* call
+// works on the current reader (rdr), RC522_UseReader switches it.
+typedef struct {
+    GPIO_TypeDef *cs_port;              // Chip select (push-pull, idle high)
+    uint16_t cs_pin;
+    GPIO_TypeDef *irq_port;             // IRQ (pull-up, active low)
+    uint16_t irq_pin;
+    uint8_t present;                    // VersionReg answered (init or health probe)
+    
+    // Shadow cache, see RC522_CACHEABLE
+    uint8_t shadow[64];
+    uint8_t shadow_valid[8];
+    
+    uint16_t reload;                    // TReload programmed in the chip (0: not yet)
+    uint8_t version;                    // VersionReg read at init (0x91 / 0x92, clones differ)
+    uint16_t next_us;                   // MFRC522_SetTimeout override
+    
+    // Command in flight (MFRC522_StartCommand .. MFRC522_FinishCommand)
+    uint8_t cmd_command;
+    uint8_t cmd_irqEn;
+    uint8_t cmd_waitIRq;
+    uint32_t cmd_start;
+    uint16_t cmd_timeout_ms;
+    
+    uint8_t crypto;                     // Crypto1 running since the last successful Auth
+    
+    // State machine (RC522_Task)
+    uint8_t state;
+    uint8_t pending;                    // Cycle requested by RC522_StartCycle
+    uint8_t buf[MFRC522_MAX_LEN];
+    uint8_t level;                      // Cascade level in progress (0..2)
+    uint8_t cl[5];                      // UID CLn bytes + BCC of that level
+    uint8_t known;                      // Bits of cl already fixed (0..32)
+    uint8_t loops;                      // Anticollision frames sent on this level
+    RC522_UidTypeDef uid;               // Being assembled
+    RC522_UidTypeDef last;              // Last complete UID
+    uint8_t atqa[2];
+    
+    // Health (RC522_Health)
+    RC522_StatsTypeDef stats;
+    uint8_t win_cmds;                   // Commands in the current error-rate window
+    uint8_t win_errs;
+    uint8_t reinit_pending;
+} RC522_ReaderTypeDef;
+
+// Door 1: CS PA4, IRQ PA0 (EXTI0)
+// Door 2: CS PA8, IRQ PA2 (EXTI2, free since USART2 is remapped to PD5/PD6)
+static RC522_ReaderTypeDef rc522_readers[RC522_NUM_READERS] = {
+    { .cs_port = GPIOA, .cs_pin = GPIO_Pin_4, .irq_port = GPIOA, .irq_pin = GPIO_Pin_0 },
+#if RC522_NUM_READERS > 1
+    { .cs_port = GPIOA, .cs_pin = GPIO_Pin_8, .irq_port = GPIOA, .irq_pin = GPIO_Pin_2 },
+#endif
+};
+
+static RC522_ReaderTypeDef *rdr = &rc522_readers[0];
+
+void RC522_UseReader(uint8_t n) {
+    if (n < RC522_NUM_READERS) {
+        rdr = &rc522_readers[n];
+    }
+}
+
+uint8_t RC522_CurrentReader(void) {
+    return rdr - rc522_readers;
+}
+
+// Helper: queue one SPI1 transfer under the current reader's chip select
+static void RC522_Submit(SPI1_XferTypeDef *x, const uint8_t *tx, uint8_t *rx, uint16_t len, uint8_t flags) {
+    x->tx = tx;
+    x->rx = rx;
+    x->len = len;
+    x->cs_port = rdr->cs_port;
+    x->cs_pin = rdr->cs_pin;
+    x->flags = flags;
+    x->done = 0;
+    x->ctx = 0;
+    SPI1_Submit(x);
+}
+
+// Shadow cache (write-through) for configuration registers only the driver writes:
+// ComIEn, DivIEn, WaterLevel, BitFraming, Mode..Demod, MfTx, MfRx, ModWidth, RFCfg..TReload.
+// Command, status, IRQ, FIFO, Control and Coll registers always go to the chip.
+static const uint8_t rc522_cacheable[8] = { 0x0C, 0x28, 0xFE, 0x33, 0xD0, 0x3F, 0x00, 0x00 };
+
+#define RC522_CACHEABLE(addr)   (rc522_cacheable[(addr) >> 3] & (1 << ((addr) & 7)))
+#define RC522_SHADOW_OK(addr)   (rdr->shadow_valid[(addr) >> 3] & (1 << ((addr) & 7)))
+
+static void MFRC522_InvalidateShadow(void) {
+    uint8_t i;
+    for (i = 0; i < 8; i++) {
+        rdr->shadow_valid[i] = 0;
+    }
 }
 
 void MFRC522_WriteRegister(uint8_t addr, uint8_t val) {
-    uint8_t addr_byte = (addr << 1) & 0x7E;
+    SPI1_XferTypeDef x;
+    uint8_t tx[2];
+    
+    tx[0] = (addr << 1) & 0x7E;
+    tx[1] = val;
+    RC522_Submit(&x, tx, 0, 2, 0);
+    SPI1_Wait(&x);
+    rdr->stats.transactions++;
+    
+    if (RC522_CACHEABLE(addr)) {
+        rdr->shadow[addr] = val;
+        rdr->shadow_valid[addr >> 3] |= 1 << (addr & 7);
+    }
+}
+
+// Always from the chip, the shadow is neither used nor updated
+uint8_t MFRC522_ReadRegisterRaw(uint8_t addr) {
+    SPI1_XferTypeDef x;
+    uint8_t tx[2];
+    uint8_t rx[2];
     
-    RC522_CS_LOW;
-    SPI_ReadWriteByte(addr_byte);
-    SPI_ReadWriteByte(val);
-    RC522_CS_HIGH;
+    tx[0] = ((addr << 1) & 0x7E) | 0x80;
+    tx[1] = 0x00; // Dummy write to read
+    RC522_Submit(&x, tx, rx, 2, 0);
+    SPI1_Wait(&x);
+    rdr->stats.transactions++;
+    return rx[1];
 }
 
 uint8_t MFRC522_ReadRegister(uint8_t addr) {
-    uint8_t addr_byte = ((addr << 1) & 0x7E) | 0x80;
     uint8_t val;
     
-    RC522_CS_LOW;
-    SPI_ReadWriteByte(addr_byte);
-    val = SPI_ReadWriteByte(0x00); // Dummy write to read
-    RC522_CS_HIGH;
+    if (RC522_CACHEABLE(addr) && RC522_SHADOW_OK(addr)) {
+        return rdr->shadow[addr];
+    }
     
+    val = MFRC522_ReadRegisterRaw(addr);
+    
+    if (RC522_CACHEABLE(addr)) {
+        rdr->shadow[addr] = val;
+        rdr->shadow_valid[addr >> 3] |= 1 << (addr & 7);
+    }
     return val;
 }
 
+// FIFO bursts: address transfer (CS kept low) chained with the data transfer
+static SPI1_XferTypeDef rc522_fifo_addr;
+static SPI1_XferTypeDef rc522_fifo_data;
+static uint8_t rc522_fifo_addr_byte;
+static uint8_t rc522_fifo_tx[RC522_FIFO_SIZE];
+
+// Burst FIFO write: one address byte, then len data bytes in a single CS window.
+// Returns once queued; data must stay valid until the next register access,
+// which is queued behind it and therefore waits for it.
+void MFRC522_WriteFIFO(const uint8_t *data, uint8_t len) {
+    if (len == 0) return;
+    if (len > RC522_FIFO_SIZE) len = RC522_FIFO_SIZE;
+    SPI1_Wait(&rc522_fifo_data);
+    rc522_fifo_addr_byte = (MFRC522_REG_FIFO_DATA << 1) & 0x7E;
+    RC522_Submit(&rc522_fifo_addr, &rc522_fifo_addr_byte, 0, 1, SPI1_KEEP_CS);
+    RC522_Submit(&rc522_fifo_data, data, 0, len, 0);
+    rdr->stats.transactions++;
+}
+
+// Burst FIFO read: repeating the address clocks out the next byte each time
+void MFRC522_ReadFIFO(uint8_t *data, uint8_t len) {
+    uint8_t i;
+    
+    if (len == 0) return;
+    if (len > RC522_FIFO_SIZE) len = RC522_FIFO_SIZE;
+    SPI1_Wait(&rc522_fifo_data);
+    rc522_fifo_addr_byte = ((MFRC522_REG_FIFO_DATA << 1) & 0x7E) | 0x80;
+    for (i = 0; i < len - 1; i++) {
+        rc522_fifo_tx[i] = rc522_fifo_addr_byte;
+    }
+    rc522_fifo_tx[len - 1] = 0x00; // 0x00 ends the read
+    RC522_Submit(&rc522_fifo_addr, &rc522_fifo_addr_byte, 0, 1, SPI1_KEEP_CS);
+    RC522_Submit(&rc522_fifo_data, rc522_fifo_tx, data, len, 0);
+    SPI1_Wait(&rc522_fifo_data);
+    rdr->stats.transactions++;
+}
+
+// All readers
+uint32_t RC522_GetSpiCount(void) {
+    uint32_t sum = 0;
+    uint8_t n;
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        sum += rc522_readers[n].stats.transactions;
+    }
+    return sum;
+}
+
+/* --- Health Counters (per reader) --- */
+// Link/chip errors (not "no card" timeouts or collisions, those are normal traffic)
+static void RC522_CountError(uint32_t *counter) {
+    (*counter)++;
+    rdr->win_errs++;
+}
+
+static void RC522_CountCommand(void) {
+    rdr->stats.commands++;
+    if (++rdr->win_cmds >= RC522_HEALTH_WINDOW) {
+        if (rdr->win_errs > RC522_HEALTH_MAX_ERR) {
+            rdr->reinit_pending = 1;
+        }
+        rdr->win_cmds = 0;
+        rdr->win_errs = 0;
+    }
+}
+
 void MFRC522_SetBitMask(uint8_t reg, uint8_t mask) {
     uint8_t tmp;
     tmp = MFRC522_ReadRegister(reg);
@@ -76,67 +260,122 @@ void MFRC522_AntennaOff(void) {
 void MFRC522_Init(void) {
     MFRC522_WriteRegister(MFRC522_REG_COMMAND, PCD_RESETPHASE);
     Delay(10); 
+    MFRC522_InvalidateShadow(); // Soft reset restored the chip defaults
     
-    MFRC522_WriteRegister(MFRC522_REG_T_MODE, 0x8D);
-    MFRC522_WriteRegister(MFRC522_REG_T_PRESCALER, 0x3E);
-    MFRC522_WriteRegister(MFRC522_REG_T_RELOAD_L, 30);
-    MFRC522_WriteRegister(MFRC522_REG_T_RELOAD_H, 0);
+    MFRC522_WriteRegister(MFRC522_REG_T_MODE, 0x80);       // TAuto: starts at end of TX, stops on RX
+    MFRC522_WriteRegister(MFRC522_REG_T_PRESCALER, 0xA9);  // 25us ticks, reload set per command
+    rdr->reload = 0;
     MFRC522_WriteRegister(MFRC522_REG_TX_ASK, 0x40);
     MFRC522_WriteRegister(MFRC522_REG_MODE, 0x3D);
+    MFRC522_WriteRegister(MFRC522_REG_COLL, 0x00);     // ValuesAfterColl=0: bits after a collision read as 0
+    rdr->version = MFRC522_ReadRegisterRaw(MFRC522_REG_VERSION);
+    rdr->present = (rdr->version != 0x00 && rdr->version != 0xFF);   // MISO floats without a chip
+    rdr->state = RC522_ST_IDLE;
+    rdr->pending = 0;
+    rdr->crypto = 0;
     
     MFRC522_AntennaOn();
 }
 
-uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLen, uint8_t *backData, uint16_t *backLen) {
-    uint8_t status = MI_ERR;
-    uint8_t irqEn = 0x00;
-    uint8_t waitIRq = 0x00;
-    uint8_t lastBits;
-    uint8_t n;
-    uint16_t i;
+// Response timeout of the next command only, 0 = by command (see RC522_TimeoutFor)
+void MFRC522_SetTimeout(uint16_t us) {
+    rdr->next_us = us;
+}
+
+// Timeout for a frame: the card answers REQA/ANTICOLL/SELECT after ~90us,
+// HALT succeeds by not answering, only memory commands take milliseconds
+static uint16_t RC522_TimeoutFor(uint8_t command, uint8_t *sendData, uint8_t sendLen) {
+    if (command == PCD_AUTHENT) {
+        return RC522_TMO_AUTH_US;
+    }
+    if (command == PCD_TRANSCEIVE && sendLen > 0) {
+        if (sendData[0] == PICC_READ) return RC522_TMO_READ_US;
+        if (sendData[0] == PICC_WRITE) return RC522_TMO_WRITE_US;
+    }
+    return RC522_TMO_SHORT_US;
+}
+
+// TReload only goes over SPI when it changes
+static void RC522_LoadTimer(uint16_t us) {
+    uint16_t reload = us / RC522_TICK_US;
+    if (reload == rdr->reload) return;
+    MFRC522_WriteRegister(MFRC522_REG_T_RELOAD_H, reload >> 8);
+    MFRC522_WriteRegister(MFRC522_REG_T_RELOAD_L, reload & 0xFF);
+    rdr->reload = reload;
+}
+
+// Load the FIFO and start a command, returns immediately
+void MFRC522_StartCommand(uint8_t command, uint8_t *sendData, uint8_t sendLen) {
+    uint16_t timeout_us;
     
+    rdr->cmd_command = command;
+    rdr->cmd_irqEn = 0x00;
+    rdr->cmd_waitIRq = 0x00;
     switch (command) {
         case PCD_AUTHENT:
-            irqEn = 0x12;
-            waitIRq = 0x10;
+            rdr->cmd_irqEn = 0x12;
+            rdr->cmd_waitIRq = 0x10;
             break;
         case PCD_TRANSCEIVE:
-            irqEn = 0x77;
-            waitIRq = 0x30;
+            rdr->cmd_irqEn = 0x77;
+            rdr->cmd_waitIRq = 0x30;
             break;
         default:
             break;
     }
     
-    MFRC522_WriteRegister(MFRC522_REG_COMM_IEN, irqEn | 0x80);
-    MFRC522_ClearBitMask(MFRC522_REG_COMM_IRQ, 0x80);
-    MFRC522_SetBitMask(MFRC522_REG_FIFO_LEVEL, 0x80);
+    RC522_CountCommand();
+    timeout_us = rdr->next_us ? rdr->next_us : RC522_TimeoutFor(command, sendData, sendLen);
+    rdr->next_us = 0;
+    RC522_LoadTimer(timeout_us);
+    rdr->cmd_timeout_ms = timeout_us / 1000 + RC522_IRQ_MARGIN_MS;
+    
+    // Route only the completion and timer IRQs to the pin (IRqInv: active low)
+    MFRC522_WriteRegister(MFRC522_REG_COMM_IEN, (rdr->cmd_waitIRq | 0x01) | 0x80);
+    MFRC522_WriteRegister(MFRC522_REG_COMM_IRQ, 0x7F);     // Set1=0: clear all IRQ bits
+    MFRC522_WriteRegister(MFRC522_REG_FIFO_LEVEL, 0x80);   // FlushBuffer
     MFRC522_WriteRegister(MFRC522_REG_COMMAND, PCD_IDLE);
     
-    for (i = 0; i < sendLen; i++) {
-        MFRC522_WriteRegister(MFRC522_REG_FIFO_DATA, sendData[i]);
-    }
+    MFRC522_WriteFIFO(sendData, sendLen);
     
     MFRC522_WriteRegister(MFRC522_REG_COMMAND, command);
     if (command == PCD_TRANSCEIVE) {
         MFRC522_SetBitMask(MFRC522_REG_BIT_FRAMING, 0x80);
     }
+    rdr->cmd_start = sys_tick_ms;
+}
+
+// Non-blocking: 1 once the IRQ pin is low or the safety timeout elapsed (no SPI traffic).
+// The pin level, not the shared EXTI flag, so another reader's IRQ cannot end this command.
+uint8_t MFRC522_CommandDone(void) {
+    return RC522_IRQ_ACTIVE ||
+           (sys_tick_ms - rdr->cmd_start) >= rdr->cmd_timeout_ms;
+}
+
+// Collect the result of the finished command. backLen is what the card sent,
+// at most backMax bytes of it are copied into backData.
+uint8_t MFRC522_FinishCommand(uint8_t *backData, uint8_t backMax, uint16_t *backLen) {
+    uint8_t status = MI_ERR;
+    uint8_t lastBits;
+    uint8_t err;
+    uint8_t n;
     
-    i = 2000;
-    do {
-        n = MFRC522_ReadRegister(MFRC522_REG_COMM_IRQ);
-        i--;
-    } while ((i != 0) && !(n & 0x01) && !(n & waitIRq));
+    n = MFRC522_ReadRegister(MFRC522_REG_COMM_IRQ);
     
     MFRC522_ClearBitMask(MFRC522_REG_BIT_FRAMING, 0x80);
     
-    if (i != 0) {
-        if (!(MFRC522_ReadRegister(MFRC522_REG_ERROR) & 0x1B)) {
-            status = MI_OK;
-            if (n & irqEn & 0x01) {
+    if ((n & 0x01) || (n & rdr->cmd_waitIRq)) {
+        err = MFRC522_ReadRegister(MFRC522_REG_ERROR);
+        if (!(err & 0x13)) {
+            // A bit collision still delivers the bits received so far
+            status = (err & 0x08) ? MI_COLLERR : MI_OK;
+            if (n & rdr->cmd_irqEn & 0x01) {
                 status = MI_NOTAGERR;
+                rdr->stats.timeouts++;
+            } else if (status == MI_COLLERR) {
+                rdr->stats.collisions++;
             }
-            if (command == PCD_TRANSCEIVE) {
+            if (rdr->cmd_command == PCD_TRANSCEIVE) {
                 n = MFRC522_ReadRegister(MFRC522_REG_FIFO_LEVEL);
                 lastBits = MFRC522_ReadRegister(MFRC522_REG_CONTROL) & 0x07;
                 if (lastBits) {
@@ -147,20 +386,30 @@ uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLen, uint
                 if (n == 0) {
                     n = 1;
                 }
-                if (n > 16) { 
-                    n = 16;
-                }
-                for (i = 0; i < n; i++) {
-                    backData[i] = MFRC522_ReadRegister(MFRC522_REG_FIFO_DATA);
+                if (n > backMax) {
+                    n = backMax;
                 }
+                MFRC522_ReadFIFO(backData, n);
             }
         } else {
             status = MI_ERR;
+            RC522_CountError(&rdr->stats.frame_errors);   // Parity, protocol, buffer overflow
         }
+    } else {
+        RC522_CountError(&rdr->stats.lost_irqs);          // Safety timeout: the chip never signalled
     }
     return status;
 }
 
+// Blocking exchange: sleep until the IRQ pin signals completion or the RC522 timer expires
+uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLen, uint8_t *backData, uint8_t backMax, uint16_t *backLen) {
+    MFRC522_StartCommand(command, sendData, sendLen);
+    while (!MFRC522_CommandDone()) {
+        __WFI();
+    }
+    return MFRC522_FinishCommand(backData, backMax, backLen);
+}
+
 uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType) {
     uint8_t status;
     uint16_t backBits;
@@ -168,7 +417,7 @@ uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType) {
     MFRC522_WriteRegister(MFRC522_REG_BIT_FRAMING, 0x07);
     TagType[0] = reqMode;
     
-    status = MFRC522_ToCard(PCD_TRANSCEIVE, TagType, 1, TagType, &backBits);
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, TagType, 1, TagType, 2, &backBits);
     
     if ((status != MI_OK) || (backBits != 0x10)) {
         status = MI_ERR;
@@ -176,42 +425,821 @@ uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType) {
     return status;
 }
 
-uint8_t MFRC522_Anticoll(uint8_t *SerNum) {
-    uint8_t status;
+/* --- CRC_A (ISO14443-3: x^16 + x^12 + x^5 + 1, reflected, preset 0x6363) --- */
+static const uint16_t crc_a_table[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+};
+
+// Table-driven CRC_A, LSB first as sent on air
+void RC522_CrcA(const uint8_t *data, uint8_t len, uint8_t *result) {
+    uint16_t crc = 0x6363;
+    while (len--) {
+        crc = (crc >> 8) ^ crc_a_table[(crc ^ *data++) & 0xFF];
+    }
+    result[0] = crc & 0xFF;
+    result[1] = crc >> 8;
+}
+
+// Received frames are already in RAM: checking them with the table costs no SPI.
+// Outgoing frames use the table too; a coprocessor pass (FIFO load, CalcCRC,
+// DivIrqReg poll, two result reads) would cost more SPI time than the frame.
+static uint8_t RC522_CheckCrc(const uint8_t *data, uint8_t len) {
+    uint8_t crc[2];
+    RC522_CrcA(data, len, crc);
+    if (crc[0] != data[len] || crc[1] != data[len + 1]) {
+        RC522_CountError(&rdr->stats.crc_errors);
+        return MI_ERR;
+    }
+    return MI_OK;
+}
+
+// HALT with its CRC_A (50 00 57 CD), constant so no CRC pass is needed
+static const uint8_t rc522_halt_frame[4] = { PICC_HALT, 0x00, 0x57, 0xCD };
+
+// 4 UID bytes + BCC, checked
+static uint8_t RC522_CheckBcc(uint8_t *serNum) {
     uint8_t i;
-    uint8_t serNumCheck = 0;
+    uint8_t bcc = 0;
+    for (i = 0; i < 4; i++) {
+        bcc ^= serNum[i];
+    }
+    return (bcc == serNum[4]) ? MI_OK : MI_ERR;
+}
+
+// SELECT frame: SEL, NVB=0x70, 4 UID bytes, BCC, CRC_A (9 bytes)
+static void RC522_BuildSelect(uint8_t *frame, uint8_t selCmd, uint8_t *serNum) {
+    uint8_t i;
+    frame[0] = selCmd;
+    frame[1] = 0x70;
+    for (i = 0; i < 5; i++) {
+        frame[2 + i] = serNum[i];
+    }
+    RC522_CrcA(frame, 7, &frame[7]);
+}
+
+// SAK answer: 1 byte + CRC_A
+static uint8_t RC522_CheckSak(uint8_t *back, uint16_t backBits) {
+    if (backBits != 24) {
+        return MI_ERR;
+    }
+    return RC522_CheckCrc(back, 1);
+}
+
+// Anticollision of one cascade level (selCmd = PICC_ANTICOLL / _CL2 / _CL3)
+uint8_t MFRC522_AnticollLevel(uint8_t selCmd, uint8_t *SerNum) {
+    uint8_t status;
     uint16_t unLen;
     
     MFRC522_WriteRegister(MFRC522_REG_BIT_FRAMING, 0x00);
-    SerNum[0] = PICC_ANTICOLL;
+    SerNum[0] = selCmd;
     SerNum[1] = 0x20;
-    status = MFRC522_ToCard(PCD_TRANSCEIVE, SerNum, 2, SerNum, &unLen);
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, SerNum, 2, SerNum, 5, &unLen);
     
     if (status == MI_OK) {
-        for (i = 0; i < 4; i++) {
-            serNumCheck ^= SerNum[i];
-        }
-        if (serNumCheck != SerNum[4]) {
-            status = MI_ERR;
-        }
+        status = RC522_CheckBcc(SerNum);
+    }
+    return status;
+}
+
+uint8_t MFRC522_Anticoll(uint8_t *SerNum) {
+    return MFRC522_AnticollLevel(PICC_ANTICOLL, SerNum);
+}
+
+// SELECT one cascade level with the 5 bytes from MFRC522_AnticollLevel
+uint8_t MFRC522_SelectTag(uint8_t selCmd, uint8_t *SerNum, uint8_t *sak) {
+    uint8_t status;
+    uint8_t buff[MFRC522_MAX_LEN];
+    uint16_t backBits;
+    
+    RC522_BuildSelect(buff, selCmd, SerNum);
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, buff, 9, buff, sizeof(buff), &backBits);
+    if (status == MI_OK) {
+        status = RC522_CheckSak(buff, backBits);
+    }
+    if (status == MI_OK) {
+        *sak = buff[0];
     }
     return status;
 }
 
 void MFRC522_Halt(void) {
     uint16_t unLen;
-    uint8_t buff[4];
-    buff[0] = PICC_HALT;
-    buff[1] = 0;
-    MFRC522_ToCard(PCD_TRANSCEIVE, buff, 2, buff, &unLen);
+    uint8_t i;
+    uint8_t buff[MFRC522_MAX_LEN];
+    for (i = 0; i < 4; i++) {
+        buff[i] = rc522_halt_frame[i];
+    }
+    MFRC522_ToCard(PCD_TRANSCEIVE, buff, 4, buff, sizeof(buff), &unLen);
+}
+
+// Send frame[0..len-1] with its CRC_A (frame needs 2 spare bytes) and expect exactly
+// backLen data bytes + CRC_A; a 4-bit NAK or any other length is MI_ERR.
+// back may be frame and must hold MFRC522_MAX_LEN.
+uint8_t MFRC522_TransceiveCrc(uint8_t *frame, uint8_t len, uint8_t *back, uint8_t backLen) {
+    uint8_t status;
+    uint16_t backBits;
+    
+    RC522_CrcA(frame, len, &frame[len]);
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, frame, len + 2, back, MFRC522_MAX_LEN, &backBits);
+    if ((status != MI_OK) || (backBits != (backLen + 2) * 8)) {
+        return MI_ERR;
+    }
+    return RC522_CheckCrc(back, backLen);
 }
 
-uint8_t RC522_Check(uint8_t *id) {
+/* --- MIFARE Classic --- */
+// Authenticate one sector (authMode = PICC_AUTHENT1A / 1B, key 6 bytes, SerNum 4 bytes)
+uint8_t MFRC522_Auth(uint8_t authMode, uint8_t BlockAddr, uint8_t *Sectorkey, uint8_t *SerNum) {
     uint8_t status;
-    status = MFRC522_Request(PICC_REQIDL, id); 
+    uint8_t i;
+    uint8_t buff[12];
+    uint16_t recvBits;
+    
+    buff[0] = authMode;
+    buff[1] = BlockAddr;
+    for (i = 0; i < 6; i++) {
+        buff[2 + i] = Sectorkey[i];
+    }
+    for (i = 0; i < 4; i++) {
+        buff[8 + i] = SerNum[i];
+    }
+    status = MFRC522_ToCard(PCD_AUTHENT, buff, 12, buff, sizeof(buff), &recvBits);
+    
+    // MFCrypto1On is only set by a successful authentication
+    if ((status != MI_OK) || !(MFRC522_ReadRegister(MFRC522_REG_STATUS2) & 0x08)) {
+        status = MI_ERR;
+    } else {
+        rdr->crypto = 1;
+    }
+    return status;
+}
+
+// Leave the authenticated state (after HALT, or before talking to another card)
+void MFRC522_StopCrypto1(void) {
+    MFRC522_ClearBitMask(MFRC522_REG_STATUS2, 0x08);
+    rdr->crypto = 0;
+}
+
+// 4-bit ACK/NAK answer of WRITE, ACK = 0xA
+static uint8_t RC522_CheckAck(uint8_t *back, uint16_t backBits) {
+    return (backBits == 4 && (back[0] & 0x0F) == 0x0A) ? MI_OK : MI_ERR;
+}
+
+// Read one 16-byte block (recvData must hold MFRC522_MAX_LEN: data + CRC_A)
+uint8_t MFRC522_Read(uint8_t blockAddr, uint8_t *recvData) {
+    recvData[0] = PICC_READ;
+    recvData[1] = blockAddr;
+    return MFRC522_TransceiveCrc(recvData, 2, recvData, 16);
+}
+
+// Write one 16-byte block: command frame, ACK, data frame, ACK
+uint8_t MFRC522_Write(uint8_t blockAddr, uint8_t *writeData) {
+    uint8_t status;
+    uint8_t i;
+    uint8_t buff[MFRC522_MAX_LEN];
+    uint16_t recvBits;
+    
+    buff[0] = PICC_WRITE;
+    buff[1] = blockAddr;
+    RC522_CrcA(buff, 2, &buff[2]);
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, buff, 4, buff, sizeof(buff), &recvBits);
+    if (status == MI_OK) {
+        status = RC522_CheckAck(buff, recvBits);
+    }
+    if (status != MI_OK) {
+        return status;
+    }
+    
+    for (i = 0; i < 16; i++) {
+        buff[i] = writeData[i];
+    }
+    RC522_CrcA(buff, 16, &buff[16]);
+    MFRC522_SetTimeout(RC522_TMO_WRITE_US);    // Data frame: the card programs EEPROM before the ACK
+    status = MFRC522_ToCard(PCD_TRANSCEIVE, buff, 18, buff, sizeof(buff), &recvBits);
+    if (status == MI_OK) {
+        status = RC522_CheckAck(buff, recvBits);
+    }
+    return status;
+}
+
+// Authenticate once, then read the 3 data blocks of a sector (0..31) into data[48]
+uint8_t MFRC522_ReadSector(uint8_t sector, uint8_t authMode, uint8_t *key, uint8_t *SerNum, uint8_t *data) {
+    uint8_t status;
+    uint8_t blk;
+    uint8_t i;
+    uint8_t buff[MFRC522_MAX_LEN];
+    
+    if (sector >= 32) {
+        return MI_ERR;
+    }
+    status = MFRC522_Auth(authMode, sector * 4 + 3, key, SerNum);
+    for (blk = 0; blk < 3 && status == MI_OK; blk++) {
+        status = MFRC522_Read(sector * 4 + blk, buff);
+        for (i = 0; i < 16; i++) {
+            data[blk * 16 + i] = buff[i];
+        }
+    }
+    return status;
+}
+
+/* --- Student Record (sector RC522_RECORD_SECTOR, blocks 0 and 1) --- */
+// Block 0: 'S' 'R' ver id[4] courses[4] rsv[4] chk
+// Block 1: name (NUL padded)
+// chk = XOR of the other 31 bytes
+#define RC522_RECORD_VER    0x01
+
+// Classic cards authenticate with the last 4 UID bytes (CL2 for 7-byte UIDs)
+static uint8_t *RC522_AuthUid(RC522_UidTypeDef *uid) {
+    return &uid->uid[uid->size - 4];
+}
+
+static uint8_t RC522_RecordCheck(const uint8_t *data) {
+    uint8_t i;
+    uint8_t chk = 0;
+    for (i = 0; i < 32; i++) {
+        if (i != 15) chk ^= data[i];
+    }
+    return chk;
+}
+
+// Decode the 32-byte record image (same layout on Classic blocks and NTAG pages)
+uint8_t RC522_ParseRecord(const uint8_t *data, RC522_RecordTypeDef *rec) {
+    uint8_t i;
+    
+    if (data[0] != 'S' || data[1] != 'R' || data[2] != RC522_RECORD_VER ||
+        data[15] != RC522_RecordCheck(data)) {
+        return MI_NOTAGERR;     // Readable, but no record on this card
+    }
+    rec->student_id = data[3] | (data[4] << 8) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 24);
+    rec->courses = data[7] | (data[8] << 8) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 24);
+    for (i = 0; i < sizeof(rec->name) - 1; i++) {
+        rec->name[i] = data[16 + i];
+    }
+    rec->name[sizeof(rec->name) - 1] = 0;
+    return MI_OK;
+}
+
+uint8_t RC522_ReadRecord(RC522_UidTypeDef *uid, uint8_t *key, RC522_RecordTypeDef *rec) {
+    uint8_t data[48];
+    
+    if (MFRC522_ReadSector(RC522_RECORD_SECTOR, PICC_AUTHENT1A, key, RC522_AuthUid(uid), data) != MI_OK) {
+        return MI_ERR;
+    }
+    return RC522_ParseRecord(data, rec);
+}
+
+uint8_t RC522_WriteRecord(RC522_UidTypeDef *uid, uint8_t *key, RC522_RecordTypeDef *rec) {
+    uint8_t data[32];
+    uint8_t i;
+    uint8_t blk = RC522_RECORD_SECTOR * 4;
+    
+    for (i = 0; i < 32; i++) {
+        data[i] = 0;
+    }
+    data[0] = 'S';
+    data[1] = 'R';
+    data[2] = RC522_RECORD_VER;
+    for (i = 0; i < 4; i++) {
+        data[3 + i] = rec->student_id >> (8 * i);
+        data[7 + i] = rec->courses >> (8 * i);
+    }
+    for (i = 0; i < sizeof(rec->name) && rec->name[i]; i++) {
+        data[16 + i] = rec->name[i];
+    }
+    data[15] = RC522_RecordCheck(data);
+    
+    if (MFRC522_Auth(PICC_AUTHENT1A, blk + 3, key, RC522_AuthUid(uid)) != MI_OK) {
+        return MI_ERR;
+    }
+    if (MFRC522_Write(blk, data) != MI_OK) {
+        return MI_ERR;
+    }
+    return MFRC522_Write(blk + 1, &data[16]);
+}
+
+/* --- Card Type --- */
+// Classification from the last SAK and the ATQA (NXP AN10833). Types outside
+// the accept mask are dropped as early as the type is known: a proprietary
+// ATQA right after REQA, a random UID after the first anticollision level,
+// everything else after the final SELECT (and halted there).
+static uint16_t rc522_accept = RC522_ACCEPT_DEFAULT;
+
+static const char *const rc522_type_names[RC522_NUM_TYPES] = {
+    "unknown", "classic1k", "classic4k", "ultralight", "desfire", "iso-dep", "proprietary", "random-uid"
+};
+
+uint8_t RC522_CardType(uint8_t sak, const uint8_t *atqa) {
+    switch (sak & 0x7F) {
+        case 0x08:
+        case 0x09:
+        case 0x28:
+            return RC522_TYPE_CLASSIC_1K;
+        case 0x18:
+        case 0x38:
+            return RC522_TYPE_CLASSIC_4K;
+        case 0x00:
+            return RC522_TYPE_ULTRALIGHT;
+        case 0x20:
+            return (atqa[0] == 0x44 && atqa[1] == 0x03) ? RC522_TYPE_DESFIRE : RC522_TYPE_ISO_DEP;
+        default:
+            return RC522_TYPE_UNKNOWN;
+    }
+}
+
+const char *RC522_TypeName(uint8_t type) {
+    return (type < RC522_NUM_TYPES) ? rc522_type_names[type] : "?";
+}
+
+void RC522_SetAccept(uint16_t mask) {
+    rc522_accept = mask;
+}
+
+uint16_t RC522_GetAccept(void) {
+    return rc522_accept;
+}
+
+// Record what is known of a rejected card for RC522_GetUid
+static uint8_t RC522_Reject(uint8_t type) {
+    rdr->uid.type = type;
+    rdr->uid.atqa[0] = rdr->atqa[0];
+    rdr->uid.atqa[1] = rdr->atqa[1];
+    rdr->last = rdr->uid;
+    rdr->stats.rejects++;
+    return RC522_EVT_REJECT;
+}
+
+/* --- Reader State Machine --- */
+// REQA -> (ANTICOLL -> SELECT) per cascade level -> HALT, one step per RC522_Task() call.
+// After RC522_EVT_UID the card stays selected until the next call, so the caller
+// may run blocking card commands (MFRC522_Auth/Read/Write, RC522_ReadRecord) first.
+
+static const uint8_t rc522_sel_cmd[3] = { PICC_ANTICOLL, PICC_ANTICOLL_CL2, PICC_ANTICOLL_CL3 };
+
+static void RC522_StartHalt(void) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        rdr->buf[i] = rc522_halt_frame[i];
+    }
+    MFRC522_StartCommand(PCD_TRANSCEIVE, rdr->buf, 4);
+    rdr->state = RC522_ST_HALT;
+}
+
+// ANTICOLL frame with the rdr->known bits already resolved (NVB = byte count | bit count).
+// RxAlign puts the first answer bit right after the last bit sent.
+static void RC522_StartAnticoll(void) {
+    uint8_t bytes = rdr->known / 8;
+    uint8_t bits = rdr->known % 8;
+    uint8_t len = bytes + (bits ? 1 : 0);
+    uint8_t i;
+    
+    rdr->buf[0] = rc522_sel_cmd[rdr->level];
+    rdr->buf[1] = ((2 + bytes) << 4) | bits;
+    for (i = 0; i < len; i++) {
+        rdr->buf[2 + i] = rdr->cl[i];
+    }
+    MFRC522_WriteRegister(MFRC522_REG_BIT_FRAMING, (bits << 4) | bits);
+    MFRC522_StartCommand(PCD_TRANSCEIVE, rdr->buf, 2 + len);
+    rdr->loops++;
+    rdr->state = RC522_ST_ANTICOLL;
+}
+
+static void RC522_StartLevel(void) {
+    uint8_t i;
+    for (i = 0; i < 5; i++) {
+        rdr->cl[i] = 0;
+    }
+    rdr->known = 0;
+    rdr->loops = 0;
+    RC522_StartAnticoll();
+}
+
+// Merge an ANTICOLL answer into rdr->cl; on a collision pick the 1 branch.
+// Returns MI_OK when all 40 bits are in, MI_COLLERR to send another frame.
+static uint8_t RC522_AnticollResult(uint8_t status, uint16_t backBits) {
+    uint8_t idx = rdr->known / 8;
+    uint8_t bits = rdr->known % 8;
+    uint8_t mask = (1 << bits) - 1;
+    uint8_t n = (backBits + 7) / 8;
+    uint8_t coll;
+    uint8_t pos;
+    uint8_t i;
+    
+    if (status != MI_OK && status != MI_COLLERR) {
+        return MI_ERR;
+    }
+    for (i = 0; i < n && idx + i < 5; i++) {
+        if (i == 0 && bits) {
+            rdr->cl[idx] = (rdr->cl[idx] & mask) | (rdr->buf[0] & ~mask);
+        } else {
+            rdr->cl[idx + i] = rdr->buf[i];
+        }
+    }
     if (status == MI_OK) {
-        status = MFRC522_Anticoll(id); 
+        return RC522_CheckBcc(rdr->cl);
+    }
+    
+    coll = MFRC522_ReadRegister(MFRC522_REG_COLL);
+    if (coll & 0x20) {                  // CollPosNotValid: collision outside the UID bits
+        return MI_ERR;
+    }
+    pos = coll & 0x1F;
+    if (pos == 0) {
+        pos = 32;
+    }
+    pos += idx * 8;                     // CollPos counts from the first FIFO byte of this frame
+    if (pos > 32) {
+        return MI_ERR;                  // In the BCC or past cl[]: glitched CollReg
+    }
+    if (pos <= rdr->known || rdr->loops > 32) {
+        return MI_ERR;                  // No progress
+    }
+    rdr->known = pos;
+    rdr->cl[(pos - 1) / 8] |= 1 << ((pos - 1) % 8);
+    return MI_COLLERR;
+}
+
+uint8_t RC522_Task(void) {
+    uint8_t status;
+    uint8_t i;
+    uint16_t backBits;
+    
+    switch (rdr->state) {
+        case RC522_ST_IDLE:
+            MFRC522_WriteRegister(MFRC522_REG_BIT_FRAMING, 0x07);
+            rdr->buf[0] = PICC_REQIDL;
+            MFRC522_StartCommand(PCD_TRANSCEIVE, rdr->buf, 1);
+            rdr->state = RC522_ST_REQA;
+            break;
+            
+        case RC522_ST_REQA:
+            if (!MFRC522_CommandDone()) break;
+            status = MFRC522_FinishCommand(rdr->buf, sizeof(rdr->buf), &backBits);
+            // Several cards with different ATQAs collide here, that is still a card
+            if ((status != MI_OK && status != MI_COLLERR) || (backBits != 0x10)) {
+                rdr->state = RC522_ST_IDLE;     // No card, nothing to halt
+                break;
+            }
+            rdr->atqa[0] = rdr->buf[0];
+            rdr->atqa[1] = rdr->buf[1];
+            
+            rdr->level = 0;
+            rdr->uid.size = 0;
+            rdr->uid.sak = 0;
+            // No bit frame anticollision bit: it cannot be selected the usual way.
+            // Only trusted without a collision (bits after one read as 0).
+            if (status == MI_OK && !(rdr->atqa[0] & 0x1F) &&
+                !(rc522_accept & RC522_TYPE_MASK(RC522_TYPE_PROPRIETARY))) {
+                rdr->state = RC522_ST_IDLE;
+                return RC522_Reject(RC522_TYPE_PROPRIETARY);
+            }
+            RC522_StartLevel();
+            return RC522_EVT_CARD;
+            
+        case RC522_ST_ANTICOLL:
+            if (!MFRC522_CommandDone()) break;
+            status = MFRC522_FinishCommand(rdr->buf, sizeof(rdr->buf), &backBits);
+            status = RC522_AnticollResult(status, backBits);
+            if (status == MI_COLLERR) {
+                RC522_StartAnticoll();          // Next frame down the chosen branch
+                break;
+            }
+            if (status != MI_OK) {
+                RC522_StartHalt();
+                return RC522_EVT_ERROR;
+            }
+            // Single-size random ID (phones): a new UID every tap, not worth a SELECT.
+            // The card stays READY and falls back to IDLE on the next REQA.
+            if (rdr->level == 0 && rdr->cl[0] == 0x08 &&
+                !(rc522_accept & RC522_TYPE_MASK(RC522_TYPE_RANDOM_UID))) {
+                for (i = 0; i < 4; i++) {
+                    rdr->uid.uid[i] = rdr->cl[i];
+                }
+                rdr->uid.size = 4;
+                rdr->state = RC522_ST_IDLE;
+                return RC522_Reject(RC522_TYPE_RANDOM_UID);
+            }
+            RC522_BuildSelect(rdr->buf, rc522_sel_cmd[rdr->level], rdr->cl);
+            if (rdr->known % 8) {
+                MFRC522_WriteRegister(MFRC522_REG_BIT_FRAMING, 0x00);
+            }
+            MFRC522_StartCommand(PCD_TRANSCEIVE, rdr->buf, 9);
+            rdr->state = RC522_ST_SELECT;
+            break;
+            
+        case RC522_ST_SELECT:
+            if (!MFRC522_CommandDone()) break;
+            status = MFRC522_FinishCommand(rdr->buf, sizeof(rdr->buf), &backBits);
+            if (status == MI_OK) {
+                status = RC522_CheckSak(rdr->buf, backBits);
+            }
+            if (status != MI_OK) {
+                RC522_StartHalt();
+                return RC522_EVT_ERROR;
+            }
+            rdr->uid.sak = rdr->buf[0];
+            
+            if ((rdr->uid.sak & PICC_SAK_CASCADE) && rdr->level < 2) {
+                // CT + 3 UID bytes, the rest follows on the next level
+                for (i = 1; i < 4; i++) {
+                    rdr->uid.uid[rdr->uid.size++] = rdr->cl[i];
+                }
+                rdr->level++;
+                RC522_StartLevel();
+                break;
+            }
+            for (i = 0; i < 4; i++) {
+                rdr->uid.uid[rdr->uid.size++] = rdr->cl[i];
+            }
+            rdr->uid.type = RC522_CardType(rdr->uid.sak, rdr->atqa);
+            if (!(rc522_accept & RC522_TYPE_MASK(rdr->uid.type))) {
+                RC522_StartHalt();      // Halted, so it stays quiet while in the field
+                return RC522_Reject(rdr->uid.type);
+            }
+            rdr->uid.atqa[0] = rdr->atqa[0];
+            rdr->uid.atqa[1] = rdr->atqa[1];
+            rdr->last = rdr->uid;
+            rdr->state = RC522_ST_SELECTED;
+            return RC522_EVT_UID;
+            
+        case RC522_ST_SELECTED:
+            RC522_StartHalt();  // Encrypted if the caller authenticated
+            break;
+            
+        case RC522_ST_HALT:
+            if (!MFRC522_CommandDone()) break;
+            MFRC522_FinishCommand(rdr->buf, sizeof(rdr->buf), &backBits);
+            if (rdr->crypto) {
+                MFRC522_StopCrypto1();
+            }
+            rdr->state = RC522_ST_IDLE;
+            break;
+            
+        default:
+            rdr->state = RC522_ST_IDLE;
+            break;
     }
-    MFRC522_Halt(); 
+    return RC522_EVT_NONE;
+}
+
+// 1 while an exchange is in progress
+uint8_t RC522_Busy(void) {
+    return rdr->state != RC522_ST_IDLE;
+}
+
+// UID (4, 7 or 10 bytes), SAK, ATQA and type of the last RC522_EVT_UID (or RC522_EVT_REJECT)
+void RC522_GetUid(RC522_UidTypeDef *uid) {
+    *uid = rdr->last;
+}
+
+// Blocking wrapper: runs one full REQA/ANTICOLL/SELECT/HALT cycle
+uint8_t RC522_Check(RC522_UidTypeDef *uid) {
+    uint8_t status = MI_ERR;
+    uint8_t evt;
+    do {
+        evt = RC522_Task();
+        if (evt == RC522_EVT_UID) {
+            RC522_GetUid(uid);
+            status = MI_OK;
+        }
+    } while (RC522_Busy());
     return status;
 }
+
+// Blocking inventory: select and halt every card in the field, one per cycle.
+// Halted cards ignore REQA, so each new cycle finds the next one.
+// Returns the number of UIDs written to list.
+uint8_t RC522_Inventory(RC522_UidTypeDef *list, uint8_t max) {
+    uint8_t count = 0;
+    uint8_t cycles = 0;
+    uint8_t found = 0;
+    uint8_t evt;
+    
+    while (cycles < max + 2) {
+        evt = RC522_Task();
+        if (evt == RC522_EVT_CARD) {
+            found = 1;
+        } else if (evt == RC522_EVT_UID && count < max) {
+            RC522_GetUid(&list[count++]);
+        }
+        if (!RC522_Busy()) {
+            if (!found || count >= max) break;     // Field is quiet
+            found = 0;
+            cycles++;
+        }
+    }
+    return count;
+}
+
+/* --- Reader Scheduler --- */
+// The readers share SPI1 but each runs its own state machine. Every command is
+// started and then polled, so while one reader waits for a card (or a timeout)
+// the scheduler steps the others.
+static uint8_t rc522_rr = 0;            // Reader the next RC522_Scan visits first
+static uint32_t rc522_seq = 0;
+static uint8_t rc522_antenna = 1;       // Last RC522_AntennaAll, for readers that show up later
+
+// Reset and configure every reader; readers that do not answer are skipped until
+// RC522_Health finds them
+void RC522_InitReaders(void) {
+    uint8_t n;
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        rdr = &rc522_readers[n];
+        MFRC522_Init();
+    }
+    rdr = &rc522_readers[0];
+}
+
+uint8_t RC522_ReaderPresent(uint8_t n) {
+    return (n < RC522_NUM_READERS) && rc522_readers[n].present;
+}
+
+// Field on/off on all readers (the current reader is kept)
+void RC522_AntennaAll(uint8_t on) {
+    RC522_ReaderTypeDef *cur = rdr;
+    uint8_t n;
+    rc522_antenna = on;
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        rdr = &rc522_readers[n];
+        if (!rdr->present) continue;
+        if (on) {
+            MFRC522_AntennaOn();
+        } else {
+            MFRC522_AntennaOff();
+        }
+    }
+    rdr = cur;
+}
+
+// One REQA cycle on every idle reader, run by the following RC522_Scan calls
+void RC522_StartCycle(void) {
+    uint8_t n;
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        if (rc522_readers[n].present && rc522_readers[n].state == RC522_ST_IDLE) {
+            rc522_readers[n].pending = 1;
+        }
+    }
+}
+
+// 1 while any reader has a cycle pending or in progress
+uint8_t RC522_ScanBusy(void) {
+    uint8_t n;
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        if (rc522_readers[n].pending || rc522_readers[n].state != RC522_ST_IDLE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 1 if RC522_Scan can make progress now (for the idle loop)
+uint8_t RC522_ScanReady(void) {
+    RC522_ReaderTypeDef *cur = rdr;
+    uint8_t ready = 0;
+    uint8_t n;
+    for (n = 0; n < RC522_NUM_READERS && !ready; n++) {
+        rdr = &rc522_readers[n];
+        ready = rdr->pending || rdr->state == RC522_ST_SELECTED ||
+                (rdr->state != RC522_ST_IDLE && MFRC522_CommandDone());
+    }
+    rdr = cur;
+    return ready;
+}
+
+// Step each reader with work once, round robin. Stops at the first event and
+// leaves that reader current, so a selected card can be read before the next call.
+// UID events are numbered in the order they happened across all readers.
+uint8_t RC522_Scan(RC522_ScanTypeDef *scan) {
+    uint8_t k;
+    uint8_t n;
+    uint8_t evt;
+    
+    for (k = 0; k < RC522_NUM_READERS; k++) {
+        n = (rc522_rr + k) % RC522_NUM_READERS;
+        rdr = &rc522_readers[n];
+        if (!rdr->pending && rdr->state == RC522_ST_IDLE) continue;
+        rdr->pending = 0;
+        evt = RC522_Task();
+        if (evt == RC522_EVT_NONE) continue;
+        
+        rc522_rr = (n + 1) % RC522_NUM_READERS;
+        scan->reader = n;
+        if (evt == RC522_EVT_UID) {
+            scan->seq = ++rc522_seq;
+            scan->time_ms = sys_tick_ms;
+            scan->uid = rdr->last;
+        } else if (evt == RC522_EVT_REJECT) {
+            scan->uid = rdr->last;
+        }
+        return evt;
+    }
+    return RC522_EVT_NONE;
+}
+
+/* --- Health Monitor --- */
+// One raw register read every RC522_HEALTH_MS, on the readers in turn, alternating
+// between VersionReg (SPI link, chip alive) and TxControlReg against the shadow
+// (a brown-out reset clears the antenna bits). Readers absent at init get one
+// VersionReg probe per turn, so a late power-up or a hot-plugged door is
+// picked up. Reinit only between cycles.
+static uint32_t rc522_health_last = 0;
+static uint8_t rc522_health_step = 0;
+static uint8_t rc522_health_reader = 0;
+
+static uint8_t RC522_HealthCheck(void) {
+    uint8_t val;
+    
+    rc522_health_step ^= 1;
+    if (rc522_health_step) {
+        val = MFRC522_ReadRegisterRaw(MFRC522_REG_VERSION);
+        return (val == rdr->version) && (val != 0x00) && (val != 0xFF);
+    }
+    val = MFRC522_ReadRegisterRaw(MFRC522_REG_TX_CONTROL);
+    return val == MFRC522_ReadRegister(MFRC522_REG_TX_CONTROL);
+}
+
+// Returns the number of readers reinitialised (the current reader is kept)
+uint8_t RC522_Health(void) {
+    RC522_ReaderTypeDef *cur = rdr;
+    uint8_t reinits = 0;
+    uint8_t antenna;
+    uint8_t val;
+    uint8_t n;
+    
+    if ((sys_tick_ms - rc522_health_last) >= RC522_HEALTH_MS) {
+        rdr = &rc522_readers[rc522_health_reader];
+        if (rdr->state == RC522_ST_IDLE) {
+            rc522_health_last = sys_tick_ms;
+            if (rdr->present) {
+                if (!RC522_HealthCheck()) {
+                    rdr->stats.health_fails++;
+                    rdr->reinit_pending = 1;
+                }
+            } else {
+                val = MFRC522_ReadRegisterRaw(MFRC522_REG_VERSION);
+                if (val != 0x00 && val != 0xFF) {
+                    rdr->reinit_pending = 1;
+                }
+            }
+            if (!rdr->present || !rc522_health_step) {     // Both checks done, next reader
+                rc522_health_step = 0;
+                rc522_health_reader = (rc522_health_reader + 1) % RC522_NUM_READERS;
+            }
+        }
+    }
+    
+    for (n = 0; n < RC522_NUM_READERS; n++) {
+        rdr = &rc522_readers[n];
+        if (!rdr->reinit_pending || rdr->state != RC522_ST_IDLE) continue;
+        
+        // Keep the antenna as the poll scheduler left it
+        antenna = rdr->present ? (MFRC522_ReadRegister(MFRC522_REG_TX_CONTROL) & 0x03) : rc522_antenna;
+        rdr->reinit_pending = 0;
+        rdr->win_cmds = 0;
+        rdr->win_errs = 0;
+        rdr->stats.reinits++;
+        MFRC522_Init();
+        if (!antenna) {
+            MFRC522_AntennaOff();
+        }
+        reinits++;
+    }
+    rdr = cur;
+    return reinits;
+}
+
+void RC522_GetStats(uint8_t n, RC522_StatsTypeDef *st) {
+    if (n < RC522_NUM_READERS) {
+        *st = rc522_readers[n].stats;
+    }
+}
@@ -0,0 +1,164 @@
+/* Core/Src/rfid_poll.c */
+#include "rfid_poll.h"
+#include "rc522.h"
+
+// Millisecond tick from main.c
+extern volatile uint32_t sys_tick_ms;
+
+// Cycle interval per mode (POLL_OFF: antenna wake period)
+static const uint16_t poll_interval[3] = { POLL_WAKE_MS, POLL_SLOW_MS, POLL_FAST_MS };
+
+static uint8_t poll_mode = POLL_FAST;
+static uint8_t poll_antenna = 1;        // MFRC522_Init leaves the field on
+static uint8_t poll_waking = 0;         // Antenna just switched on, waiting POLL_SETTLE_MS
+static uint32_t poll_last = 0;          // Start of the last cycle (or antenna switch-on)
+static uint8_t poll_cycle = 0;          // A cycle started by Poll_Due is running
+static uint8_t poll_card = 0;           // ...and got an answer to REQA
+static uint32_t poll_cycle_start;
+static uint32_t poll_empty;             // Start of the last cycle that found the field empty
+static uint8_t poll_empty_valid = 0;
+static uint32_t poll_mode_start = 0;
+static Poll_StatsTypeDef poll_stats[3];
+
+static void Poll_Antenna(uint8_t on) {
+    if (on == poll_antenna) return;
+    poll_antenna = on;
+    if (on) {
+        RC522_AntennaAll(1);
+        poll_waking = 1;
+        poll_last = sys_tick_ms;
+    } else {
+        RC522_AntennaAll(0);
+    }
+}
+
+void Poll_Init(void) {
+    poll_mode_start = sys_tick_ms;
+    Poll_ResetStats();
+    Poll_SetMode(POLL_OFF);
+}
+
+// Mode for the current time of day (seconds since midnight)
+uint8_t Poll_ModeFor(uint32_t now_s, uint32_t att_s, uint32_t late_s, uint8_t active) {
+    if (!active) {
+        return POLL_OFF;
+    }
+    if (now_s >= att_s && now_s < att_s + POLL_FAST_WINDOW_S && now_s < late_s) {
+        return POLL_FAST;
+    }
+    return POLL_SLOW;
+}
+
+void Poll_SetMode(uint8_t mode) {
+    uint32_t now = sys_tick_ms;
+
+    if (mode == poll_mode) return;
+    poll_stats[poll_mode].time_ms += now - poll_mode_start;
+    poll_mode_start = now;
+    poll_mode = mode;
+    poll_empty_valid = 0;   // Time-to-detect only within one mode
+
+    if (mode != POLL_OFF) {
+        Poll_Antenna(1);
+    } else if (!RC522_ScanBusy()) {
+        Poll_Antenna(0);    // Otherwise when the running cycle ends
+    }
+}
+
+uint8_t Poll_GetMode(void) {
+    return poll_mode;
+}
+
+// 1 when a new REQA cycle should start now (RC522_StartCycle), never while readers are busy
+uint8_t Poll_Due(void) {
+    uint32_t now = sys_tick_ms;
+
+    if (RC522_ScanBusy()) return 0;
+
+    if (!poll_antenna) {
+        if ((now - poll_last) >= POLL_WAKE_MS) {
+            Poll_Antenna(1);
+        }
+        return 0;
+    }
+    if (poll_waking) {
+        if ((now - poll_last) < POLL_SETTLE_MS) return 0;
+        poll_waking = 0;
+    } else if ((now - poll_last) < poll_interval[poll_mode]) {
+        return 0;
+    }
+
+    poll_last = now;
+    poll_cycle = 1;
+    poll_card = 0;
+    poll_cycle_start = now;
+    poll_stats[poll_mode].cycles++;
+    return 1;
+}
+
+// Feed every RC522_Task() result
+void Poll_Event(uint8_t evt) {
+    uint32_t now = sys_tick_ms;
+    uint32_t ttd;
+    Poll_StatsTypeDef *st = &poll_stats[poll_mode];
+
+    if (evt == RC522_EVT_CARD) {
+        poll_card = 1;
+    } else if (evt == RC522_EVT_UID) {
+        st->detects++;
+        if (poll_empty_valid) {
+            ttd = now - poll_empty;
+            st->ttd_count++;
+            st->ttd_sum_ms += ttd;
+            if (ttd > st->ttd_max_ms) st->ttd_max_ms = ttd;
+            poll_empty_valid = 0;   // Next card counts from the next empty cycle
+        }
+    }
+
+    if (poll_cycle && !RC522_ScanBusy()) {
+        poll_cycle = 0;
+        if (!poll_card) {
+            poll_empty = poll_cycle_start;
+            poll_empty_valid = 1;
+        }
+        if (poll_mode == POLL_OFF) {
+            Poll_Antenna(0);
+            poll_last = now;
+        }
+    }
+}
+
+// Time until Poll_Due has something to do, capped to max_ms
+uint32_t Poll_NextDelay(uint32_t max_ms) {
+    uint32_t elapsed = sys_tick_ms - poll_last;
+    uint32_t wait;
+
+    if (RC522_ScanBusy()) {
+        return max_ms;      // Idle_Wait returns early once a reader is ready anyway
+    }
+    if (!poll_antenna) {
+        wait = POLL_WAKE_MS;
+    } else if (poll_waking) {
+        wait = POLL_SETTLE_MS;
+    } else {
+        wait = poll_interval[poll_mode];
+    }
+    wait = (elapsed >= wait) ? 1 : wait - elapsed;
+    return (wait < max_ms) ? wait : max_ms;
+}
+
+void Poll_GetStats(uint8_t mode, Poll_StatsTypeDef *st) {
+    *st = poll_stats[mode];
+    if (mode == poll_mode) {
+        st->time_ms += sys_tick_ms - poll_mode_start;
+    }
+}
+
+void Poll_ResetStats(void) {
+    uint8_t i;
+    Poll_StatsTypeDef zero = { 0 };
+    for (i = 0; i < 3; i++) {
+        poll_stats[i] = zero;
+    }
+    poll_mode_start = sys_tick_ms;
+}
@@ -0,0 +1,202 @@
+/* Core/Src/spi1_dma.c */
+#include "spi1_dma.h"
+#include "stm32f10x.h"
+
+// Queued full-duplex transfers on SPI1, one at a time, in submission order.
+// Short transfers are polled inline, longer ones run on DMA1 Ch2 (RX) / Ch3 (TX)
+// and complete from the RX channel interrupt.
+
+static SPI1_XferTypeDef *spi1_head = 0;
+static SPI1_XferTypeDef *spi1_tail = 0;
+static SPI1_XferTypeDef * volatile spi1_active = 0;
+static uint8_t spi1_kicking = 0;
+
+#ifndef SPI1_HOST
+
+#define SPI1_DMA_RX DMA1_Channel2
+#define SPI1_DMA_TX DMA1_Channel3
+
+static uint8_t spi1_dummy_tx = 0x00;
+static uint8_t spi1_dummy_rx;
+
+static void SPI1_HW_Select(GPIO_TypeDef *port, uint16_t pin, uint8_t active) {
+    if (active) {
+        GPIO_ResetBits(port, pin);
+    } else {
+        GPIO_SetBits(port, pin);
+    }
+}
+
+static uint8_t SPI1_ReadWriteByte(uint8_t data) {
+    while (SPI_I2S_GetFlagStatus(SPI1, SPI_I2S_FLAG_TXE) == RESET);
+    SPI_I2S_SendData(SPI1, data);
+    while (SPI_I2S_GetFlagStatus(SPI1, SPI_I2S_FLAG_RXNE) == RESET);
+    return SPI_I2S_ReceiveData(SPI1);
+}
+
+static void SPI1_HW_Start(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    uint16_t i;
+    uint8_t b;
+
+    if (len < SPI1_DMA_MIN) {
+        for (i = 0; i < len; i++) {
+            b = SPI1_ReadWriteByte(tx ? tx[i] : 0x00);
+            if (rx) rx[i] = b;
+        }
+        SPI1_Complete();
+        return;
+    }
+
+    // Channels stay configured from SPI1_DMA_Init, only buffers and counts change
+    SPI1_DMA_RX->CCR &= ~(DMA_CCR1_EN | DMA_CCR1_MINC);
+    SPI1_DMA_TX->CCR &= ~(DMA_CCR1_EN | DMA_CCR1_MINC);
+    SPI1_DMA_RX->CMAR = rx ? (uint32_t)rx : (uint32_t)&spi1_dummy_rx;
+    SPI1_DMA_TX->CMAR = tx ? (uint32_t)tx : (uint32_t)&spi1_dummy_tx;
+    if (rx) SPI1_DMA_RX->CCR |= DMA_CCR1_MINC;
+    if (tx) SPI1_DMA_TX->CCR |= DMA_CCR1_MINC;
+    SPI1_DMA_RX->CNDTR = len;
+    SPI1_DMA_TX->CNDTR = len;
+
+    SPI1_DMA_RX->CCR |= DMA_CCR1_EN;
+    SPI1_DMA_TX->CCR |= DMA_CCR1_EN;  // TXE is already set, the first byte goes out now
+}
+
+static const SPI1_BackendTypeDef spi1_hw_backend = { SPI1_HW_Select, SPI1_HW_Start };
+static const SPI1_BackendTypeDef *spi1_backend = &spi1_hw_backend;
+
+// RX transfer complete: the last byte has been clocked in
+void DMA1_Channel2_IRQHandler(void) {
+    if (DMA_GetITStatus(DMA1_IT_TC2) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_GL2);
+        SPI1_DMA_RX->CCR &= ~DMA_CCR1_EN;
+        SPI1_DMA_TX->CCR &= ~DMA_CCR1_EN;
+        SPI1_Complete();
+    }
+}
+
+// SPI1 itself (pins, mode, baud) is set up by SPI_Configuration in main.c
+void SPI1_DMA_Init(void) {
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    DMA_DeInit(SPI1_DMA_RX);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&SPI1->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&spi1_dummy_rx;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = 1;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;   // RX must never overrun
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(SPI1_DMA_RX, &DMA_InitStructure);
+
+    DMA_DeInit(SPI1_DMA_TX);
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&spi1_dummy_tx;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_Init(SPI1_DMA_TX, &DMA_InitStructure);
+
+    DMA_ITConfig(SPI1_DMA_RX, DMA_IT_TC, ENABLE);
+
+    // Requests are ignored while a channel is disabled, so the polled path still works
+    SPI_I2S_DMACmd(SPI1, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel2_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 2;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+}
+
+#else
+
+static const SPI1_BackendTypeDef *spi1_backend = 0;
+
+void SPI1_DMA_Init(void) {
+}
+
+#endif /* SPI1_HOST */
+
+// Replace the transport (fake SPI on the host, NULL restores the default)
+void SPI1_SetBackend(const SPI1_BackendTypeDef *backend) {
+#ifndef SPI1_HOST
+    spi1_backend = backend ? backend : &spi1_hw_backend;
+#else
+    spi1_backend = backend;
+#endif
+}
+
+// Start queued transfers until one is left running on DMA (or the queue is empty)
+static void SPI1_Kick(void) {
+    SPI1_XferTypeDef *x;
+
+    __disable_irq();
+    if (spi1_kicking) {     // Completed from inside backend->start, the loop below continues
+        __enable_irq();
+        return;
+    }
+    spi1_kicking = 1;
+    while (!spi1_active && spi1_head) {
+        x = spi1_head;
+        spi1_head = x->next;
+        if (!spi1_head) spi1_tail = 0;
+        x->status = SPI1_XFER_ACTIVE;
+        spi1_active = x;
+        __enable_irq();
+
+        if (x->cs_port) spi1_backend->select(x->cs_port, x->cs_pin, 1);
+        spi1_backend->start(x->tx, x->rx, x->len);
+
+        __disable_irq();
+    }
+    spi1_kicking = 0;
+    __enable_irq();
+}
+
+// Called by the backend when the active transfer has finished
+void SPI1_Complete(void) {
+    SPI1_XferTypeDef *x = spi1_active;
+
+    if (!x) return;
+    if (x->cs_port && !(x->flags & SPI1_KEEP_CS)) {
+        spi1_backend->select(x->cs_port, x->cs_pin, 0);
+    }
+    spi1_active = 0;
+    x->status = SPI1_XFER_DONE;
+    if (x->done) x->done(x);
+    SPI1_Kick();
+}
+
+// Queue a transfer, returns at once; x must stay valid until status is DONE
+void SPI1_Submit(SPI1_XferTypeDef *x) {
+    x->next = 0;
+    x->status = SPI1_XFER_QUEUED;
+    __disable_irq();
+    if (spi1_tail) {
+        spi1_tail->next = x;
+    } else {
+        spi1_head = x;
+    }
+    spi1_tail = x;
+    __enable_irq();
+    SPI1_Kick();
+}
+
+void SPI1_Wait(SPI1_XferTypeDef *x) {
+    while (x->status == SPI1_XFER_QUEUED || x->status == SPI1_XFER_ACTIVE);
+}
+
+// Blocking: queue and wait (earlier queued transfers go first)
+void SPI1_Transfer(SPI1_XferTypeDef *x) {
+    SPI1_Submit(x);
+    SPI1_Wait(x);
+}
+
+uint8_t SPI1_Idle(void) {
+    return spi1_active == 0 && spi1_head == 0;
+}
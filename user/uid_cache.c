@@ -0,0 +1,99 @@
+/* Core/Src/uid_cache.c */
+#include "uid_cache.h"
+
+// Open-addressing hash table, linear probing, no allocation.
+// Entries older than the window are free for reuse but keep probe chains intact.
+// When the table is full the least recently seen entry is replaced.
+
+typedef struct {
+    uint8_t used;
+    uint8_t size;
+    uint8_t uid[10];
+    uint32_t time;      // Last accepted or repeated tap (ms)
+} UidCache_EntryTypeDef;
+
+static UidCache_EntryTypeDef uid_cache[UID_CACHE_SIZE];
+static uint32_t uid_cache_window = UID_CACHE_WINDOW_MS;
+
+// FNV-1a over the UID bytes
+static uint8_t UidCache_Hash(const RC522_UidTypeDef *uid) {
+    uint32_t h = 2166136261UL;
+    uint8_t i;
+    for (i = 0; i < uid->size; i++) {
+        h = (h ^ uid->uid[i]) * 16777619UL;
+    }
+    return (h ^ (h >> 16)) & (UID_CACHE_SIZE - 1);
+}
+
+static uint8_t UidCache_Match(const UidCache_EntryTypeDef *e, const RC522_UidTypeDef *uid) {
+    uint8_t i;
+    if (e->size != uid->size) return 0;
+    for (i = 0; i < uid->size; i++) {
+        if (e->uid[i] != uid->uid[i]) return 0;
+    }
+    return 1;
+}
+
+// Slot holding uid, or -1
+static int8_t UidCache_Find(const RC522_UidTypeDef *uid) {
+    uint8_t slot = UidCache_Hash(uid);
+    uint8_t n;
+    for (n = 0; n < UID_CACHE_SIZE; n++) {
+        if (!uid_cache[slot].used) return -1;   // End of the probe chain
+        if (UidCache_Match(&uid_cache[slot], uid)) return slot;
+        slot = (slot + 1) & (UID_CACHE_SIZE - 1);
+    }
+    return -1;
+}
+
+void UidCache_Clear(void) {
+    uint8_t i;
+    for (i = 0; i < UID_CACHE_SIZE; i++) {
+        uid_cache[i].used = 0;
+    }
+}
+
+void UidCache_SetWindow(uint32_t ms) {
+    uid_cache_window = ms;
+}
+
+// 1 if uid was accepted within the window; a repeat restarts its window
+uint8_t UidCache_Recent(const RC522_UidTypeDef *uid, uint32_t now) {
+    int8_t slot = UidCache_Find(uid);
+    if (slot < 0 || (now - uid_cache[slot].time) >= uid_cache_window) {
+        return 0;
+    }
+    uid_cache[slot].time = now;     // Card left lying on the reader stays suppressed
+    return 1;
+}
+
+void UidCache_Add(const RC522_UidTypeDef *uid, uint32_t now) {
+    int8_t slot = UidCache_Find(uid);
+    uint8_t probe;
+    uint8_t oldest;
+    uint8_t n;
+    uint8_t i;
+
+    if (slot < 0) {
+        // First free or expired slot on the chain, else the oldest one
+        probe = UidCache_Hash(uid);
+        oldest = probe;
+        for (n = 0; n < UID_CACHE_SIZE; n++) {
+            if (!uid_cache[probe].used || (now - uid_cache[probe].time) >= uid_cache_window) {
+                oldest = probe;
+                break;
+            }
+            if ((now - uid_cache[probe].time) > (now - uid_cache[oldest].time)) {
+                oldest = probe;
+            }
+            probe = (probe + 1) & (UID_CACHE_SIZE - 1);
+        }
+        slot = oldest;
+        uid_cache[slot].used = 1;
+        uid_cache[slot].size = uid->size;
+        for (i = 0; i < uid->size; i++) {
+            uid_cache[slot].uid[i] = uid->uid[i];
+        }
+    }
+    uid_cache[slot].time = now;
+}